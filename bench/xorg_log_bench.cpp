@@ -0,0 +1,135 @@
+#include "config.h"
+#include "xorg_log.h"
+
+#include <QCoreApplication>
+
+using namespace wmm;
+
+/**
+ * the scanner as it was before the log got mapped, kept here only to
+ * compare against
+ */
+static XorgLog::Result scan_by_line(const QString& path)
+{
+    static QRegExp aiglx_err("\\(EE\\)\\s+AIGLX error");
+    static QRegExp dri_ok("direct rendering: DRI\\d+ enabled");
+    static QRegExp swrast("GLX: Initialized DRISWRAST");
+
+    QFile f(path);
+    if (!f.open(QFile::ReadOnly)) {
+        return XorgLog::Unreadable;
+    }
+
+    QTextStream ts(&f);
+    while (!ts.atEnd()) {
+        QString ln = ts.readLine();
+        if (aiglx_err.indexIn(ln) != -1) return XorgLog::AiglxError;
+        if (dri_ok.indexIn(ln) != -1) return XorgLog::DriEnabled;
+        if (swrast.indexIn(ln) != -1) return XorgLog::SwrastUsed;
+    }
+
+    return XorgLog::NoMarker;
+}
+
+/**
+ * a log of about mb MB made of ordinary Xorg lines, the marker is the
+ * very last line so that both scanners read all of it
+ */
+static bool write_log(const QString& path, int mb)
+{
+    static const char* lines[] = {
+        "[    23.412] (II) LoadModule: \"glx\"\n",
+        "[    23.413] (II) Loading /usr/lib/xorg/modules/extensions/libglx.so\n",
+        "[    23.420] (II) Module glx: vendor=\"X.Org Foundation\"\n",
+        "[    23.421] (==) modeset(0): Depth 24, (==) framebuffer bpp 32\n",
+        "[    23.502] (II) modeset(0): EDID vendor \"AUO\", prod id 8685\n",
+        "[    23.503] (II) modeset(0): Modeline \"1920x1080\"x60.0  138.50  1920 1968 2000 2080  1080 1083 1088 1111 +hsync -vsync (66.6 kHz eP)\n",
+        "[    24.118] (II) event5  - AT Translated Set 2 keyboard: is tagged by udev as: Keyboard\n",
+        "[    24.119] (II) XINPUT: Adding extended input device \"Power Button\" (type: KEYBOARD, id 6)\n",
+    };
+
+    QFile f(path);
+    if (!f.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+
+    QByteArray block;
+    for (int i = 0; block.size() < 64 * 1024; i++) {
+        block += lines[i % (sizeof lines / sizeof lines[0])];
+    }
+
+    qint64 size = qint64(mb) * 1024 * 1024;
+    for (qint64 written = 0; written < size; written += block.size()) {
+        f.write(block);
+    }
+    f.write("[    24.300] (II) modeset(0): direct rendering: DRI2 enabled\n");
+    return true;
+}
+
+static double best_of(int runs, XorgLog::Result (*scan)(const QString&),
+        const QString& path, XorgLog::Result& result)
+{
+    double best = -1;
+    for (int i = 0; i < runs; i++) {
+        QElapsedTimer t;
+        t.start();
+        result = scan(path);
+        double ms = t.nsecsElapsed() / 1e6;
+        if (best < 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+static XorgLog::Result scan_mapped(const QString& path)
+{
+    return XorgLog::scan(path);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QList<int> sizes = {1, 10, 100};
+    if (app.arguments().size() > 1) {
+        sizes.clear();
+        for (const auto& arg: app.arguments().mid(1)) {
+            sizes.append(arg.toInt());
+        }
+    }
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qCritical() << "can not create temporary dir";
+        return 1;
+    }
+
+    QTextStream out(stdout);
+    out << "size_mb\tline_ms\tmapped_ms\tspeedup\n";
+
+    int ret = 0;
+    for (int mb: sizes) {
+        QString path = dir.path() + QString("/Xorg.%1.log").arg(mb);
+        if (!write_log(path, mb)) {
+            qCritical() << "can not write " << path;
+            return 1;
+        }
+
+        // the page cache is warm for both, as it is at login
+        XorgLog::Result old_result, new_result;
+        int runs = mb >= 100 ? 3 : 10;
+        double old_ms = best_of(runs, scan_by_line, path, old_result);
+        double new_ms = best_of(runs, scan_mapped, path, new_result);
+
+        if (old_result != new_result) {
+            qCritical() << "scanners disagree on" << mb << "MB:" << old_result << new_result;
+            ret = 1;
+        }
+
+        out << mb << '\t' << fixed << qSetRealNumberPrecision(2) << old_ms
+            << '\t' << new_ms << '\t' << old_ms / qMax(new_ms, 0.01) << "x\n";
+        out.flush();
+        QFile::remove(path);
+    }
+
+    return ret;
+}
@@ -0,0 +1,206 @@
+#include "config.h"
+#include "actions.h"
+#include "window_manager.h"
+#include "metrics.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace wmm {
+
+CancelToken::CancelToken(const shared_ptr<atomic<bool>>& flag, int deadline)
+    :_flag(flag), _deadline(deadline)
+{
+    _timer.start();
+}
+
+bool CancelToken::cancelled() const
+{
+    return *_flag || _timer.hasExpired(_deadline);
+}
+
+class ActionTask: public QRunnable {
+    public:
+        ActionTask(ActionInterface* action, bool good, const shared_ptr<atomic<bool>>& flag)
+            :_action(action), _good(good), _flag(flag) {}
+
+        void run() override {
+            QString name = C2Q(_action->name());
+            if (*_flag) {
+                wmm_info() << "skip" << name;
+                return;
+            }
+
+            CancelToken token(_flag, _action->deadline());
+            wmm_info() << "post action" << name;
+            if (_good) {
+                _action->on_good_wm(token);
+            } else {
+                _action->on_bad_wm(token);
+            }
+
+            if (token.elapsed() > _action->deadline()) {
+                wmm_warning() << QString("%1 took %2ms, over its deadline").arg(name).arg(token.elapsed());
+            }
+            Metrics::instance().observe("wmm_action_duration_ms",
+                    Metrics::label("action", name), token.elapsed());
+        }
+
+    private:
+        ActionInterface* _action;
+        bool _good;
+        shared_ptr<atomic<bool>> _flag;
+};
+
+class RunDoneTask: public QRunnable {
+    public:
+        RunDoneTask(QObject* pipeline, int id): _pipeline(pipeline), _id(id) {}
+
+        void run() override {
+            QMetaObject::invokeMethod(_pipeline, "onRunDone", Qt::QueuedConnection, Q_ARG(int, _id));
+        }
+
+    private:
+        QObject* _pipeline;
+        int _id;
+};
+
+ActionPipeline::ActionPipeline(QObject* parent)
+    :QObject(parent), _cancel(make_shared<atomic<bool>>(false))
+{
+    _pool.setMaxThreadCount(1);
+}
+
+ActionPipeline::~ActionPipeline()
+{
+    cancel();
+    _pool.waitForDone();
+}
+
+void ActionPipeline::add(ActionInterface* action)
+{
+    _actions.emplace_back(action);
+}
+
+void ActionPipeline::cancel()
+{
+    *_cancel = true;
+}
+
+void ActionPipeline::run(bool good)
+{
+    cancel();
+    _cancel = make_shared<atomic<bool>>(false);
+    ++_run;
+
+    for (const auto& act: _actions) {
+        _pool.start(new ActionTask(act.get(), good, _cancel));
+    }
+
+    // the pool has a single thread, so this comes after all of them
+    _pool.start(new RunDoneTask(this, _run));
+}
+
+void ActionPipeline::onRunDone(int run)
+{
+    if (run == _run) {
+        emit finished();
+    }
+}
+
+void SogouAction::on_good_wm(const CancelToken& token)
+{
+    if (!_currentSkin.isEmpty() && !token.cancelled()) {
+        setSkin(_currentSkin.toStdString());
+        if (!token.cancelled()) restartPanel();
+    }
+}
+
+void SogouAction::on_bad_wm(const CancelToken& token)
+{
+    saveSkin();
+    if (token.cancelled()) return;
+    setSkin("默认皮肤");
+    if (!token.cancelled()) restartPanel();
+}
+
+void SogouAction::restartPanel()
+{
+    // same as killall did, the panel comes back with the new skin
+    QDir proc("/proc");
+    uid_t uid = getuid();
+    for (const auto& entry: proc.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        bool ok = false;
+        pid_t pid = entry.toInt(&ok);
+        if (!ok) continue;
+
+        struct stat st;
+        if (stat(QFile::encodeName(proc.filePath(entry)).constData(), &st) != 0 || st.st_uid != uid) {
+            continue;
+        }
+
+        QFile comm(proc.filePath(entry) + "/comm");
+        if (comm.open(QIODevice::ReadOnly) && comm.readAll().trimmed() == "sogou-qimpanel") {
+            wmm_info() << "terminate sogou-qimpanel" << pid;
+            kill(pid, SIGTERM);
+        }
+    }
+}
+
+string SogouAction::name()
+{
+    return "update sogou skin";
+}
+
+void SogouAction::setSkin(const string& skin)
+{
+    QFile f(QDir::homePath() + QString::fromUtf8("/.config/sogou-qimpanel/main.conf"));
+    if (!f.open(QIODevice::ReadWrite)) {
+        wmm_warning() << __func__ << "conf open failed";
+        return;
+    }
+
+    QVector<QString> data;
+
+    QTextStream ts(&f);
+    while (!ts.atEnd()) {
+        QString l = ts.readLine();
+        if (l.startsWith("CurtSogouSkinType")) {
+            l = QString("CurtSogouSkinType=%1").arg(C2Q(skin));
+            wmm_info() << "replace skin: " << l;
+        }
+        data.push_back(l);
+    }
+
+    f.close();
+
+    f.open(QIODevice::Truncate|QIODevice::WriteOnly);
+    for (auto& l: data) {
+        ts << l << endl;
+    }
+}
+
+void SogouAction::saveSkin()
+{
+    QFile f(QDir::homePath() + QString::fromUtf8("/.config/sogou-qimpanel/main.conf"));
+    if (!f.open(QIODevice::ReadOnly)) {
+        wmm_warning() << __func__ << "conf open failed";
+        return;
+    }
+
+    QTextStream ts(&f);
+    while (!ts.atEnd()) {
+        QString l = ts.readLine();
+        if (l.startsWith("CurtSogouSkinType")) {
+            _currentSkin = l.replace("CurtSogouSkinType=", "");
+            wmm_info() << "save current skin: " << _currentSkin;
+            break;
+        }
+    }
+}
+
+}
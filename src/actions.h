@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * handed to each action run. actions check it between steps and give
+ * up once a newer switch took over or their deadline passed.
+ */
+class CancelToken {
+    public:
+        CancelToken(const std::shared_ptr<std::atomic<bool>>& flag, int deadline);
+
+        bool cancelled() const;
+        qint64 elapsed() const { return _timer.elapsed(); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> _flag;
+        QElapsedTimer _timer;
+        int _deadline;
+};
+
+/**
+ * run by the monitor after each wm switch, on a worker thread of
+ * ActionPipeline. runs of one action never overlap.
+ */
+struct ActionInterface {
+    virtual ~ActionInterface() {}
+    virtual void on_good_wm(const CancelToken& token) = 0;
+    virtual void on_bad_wm(const CancelToken& token) = 0;
+    virtual std::string name() = 0;
+    /**
+     * ms the action may take
+     */
+    virtual int deadline() { return 5000; }
+};
+
+/**
+ * Runs post-switch actions in order off the GUI thread. Starting a new
+ * run cancels whatever is left of the previous one, finished() is only
+ * emitted for the latest run.
+ */
+class ActionPipeline: public QObject {
+    Q_OBJECT
+    public:
+        explicit ActionPipeline(QObject* parent = nullptr);
+        ~ActionPipeline();
+
+        /**
+         * takes ownership of action
+         */
+        void add(ActionInterface* action);
+        void run(bool good);
+        void cancel();
+
+    signals:
+        void finished();
+
+    private slots:
+        void onRunDone(int run);
+
+    private:
+        std::vector<std::unique_ptr<ActionInterface>> _actions;
+        // one thread keeps actions in order
+        QThreadPool _pool;
+        std::shared_ptr<std::atomic<bool>> _cancel;
+        int _run {0};
+};
+
+class SogouAction: public ActionInterface {
+    public:
+        void on_good_wm (const CancelToken& token) override;
+        void on_bad_wm (const CancelToken& token) override;
+        std::string name() override;
+
+    private:
+        QString _currentSkin;
+
+        void setSkin(const std::string& skin);
+        void saveSkin();
+        /**
+         * what `killall sogou-qimpanel` did, without forking it
+         */
+        void restartPanel();
+};
+}
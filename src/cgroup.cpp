@@ -0,0 +1,218 @@
+#include "config.h"
+#include "cgroup.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+
+namespace wmm {
+
+static const char* const CGROUP_ROOT = "/sys/fs/cgroup";
+
+CGroupPolicy CGroupPolicy::fromJson(const QJsonObject& obj)
+{
+    CGroupPolicy p;
+    p.enabled = obj["enabled"].toBool(p.enabled);
+    p.cpuWeight = qBound(1, obj["cpu_weight"].toInt(p.cpuWeight), 10000);
+    if (obj.contains("memory_high")) {
+        p.memoryHigh = obj["memory_high"].toVariant().toString();
+    }
+    if (obj.contains("memory_max")) {
+        p.memoryMax = obj["memory_max"].toVariant().toString();
+    }
+    return p;
+}
+
+void CGroupProcess::setupChildProcess()
+{
+    // runs in the child between fork and exec, stay async-signal-safe
+    if (_procsFile.isEmpty()) return;
+
+    int fd = open(_procsFile.constData(), O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        // "0" means the writing process
+        ssize_t n = write(fd, "0", 1);
+        (void)n;
+        close(fd);
+    }
+}
+
+WMCGroup::WMCGroup(QObject* parent)
+    :QObject(parent)
+{
+    connect(&_watcher, SIGNAL(fileChanged(const QString&)),
+            this, SLOT(onEventsChanged(const QString&)));
+}
+
+QString WMCGroup::ownCGroup()
+{
+    // unified hierarchy has a single "0::/path" line
+    QFile f("/proc/self/cgroup");
+    if (!f.open(QIODevice::ReadOnly)) return QString();
+
+    for (const auto& ln: f.readAll().split('\n')) {
+        if (ln.startsWith("0::")) {
+            return QString::fromLocal8Bit(ln.mid(3));
+        }
+    }
+    return QString();
+}
+
+bool WMCGroup::writeFile(const QString& path, const QByteArray& data)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly) || f.write(data) != data.size()) {
+        wmm_warning() << "write" << data << "to" << path << "failed:" << f.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool WMCGroup::setup(const CGroupPolicy& policy)
+{
+    _policy = policy;
+    if (!_policy.enabled) {
+        _base.clear();
+        return false;
+    }
+
+    if (_base.isEmpty() && !takeOver()) return false;
+
+    // leaves kept from an earlier run or config get the limits of now
+    QDir base(_base);
+    for (const auto& name: base.entryList(QStringList() << "wm-*", QDir::Dirs)) {
+        applyLimits(base.filePath(name));
+    }
+    return true;
+}
+
+bool WMCGroup::takeOver()
+{
+    QString own = ownCGroup();
+    if (own.isEmpty() || !QFile::exists(QString("%1/cgroup.controllers").arg(CGROUP_ROOT))) {
+        wmm_info() << "cgroup v2 is not available";
+        return false;
+    }
+
+    // the monitor of another display, or an earlier exec of ours,
+    // has moved us to the switcher leaf already
+    if (own.endsWith("/switcher")) {
+        own.chop(strlen("/switcher"));
+    }
+
+    QString base = QString("%1%2").arg(CGROUP_ROOT).arg(own);
+    QFile ctrls(base + "/cgroup.controllers");
+    if (!ctrls.open(QIODevice::ReadOnly)) return false;
+    auto available = ctrls.readAll().simplified().split(' ');
+    if (!available.contains("cpu") || !available.contains("memory")
+            || access(QFile::encodeName(base + "/cgroup.subtree_control").constData(), W_OK) != 0) {
+        wmm_info() << "cgroup" << own << "is not delegated to us";
+        return false;
+    }
+
+    // processes may only live in leaves once controllers are enabled
+    QString self = base + "/switcher";
+    if (!QDir().mkpath(self)
+            || !writeFile(self + "/cgroup.procs", QByteArray::number(getpid()))
+            || !writeFile(base + "/cgroup.subtree_control", "+cpu +memory")) {
+        wmm_info() << "can not take over cgroup" << own;
+        return false;
+    }
+
+    _base = base;
+    wmm_info() << "wm cgroups live under" << _base;
+    return true;
+}
+
+void WMCGroup::applyLimits(const QString& dir)
+{
+    writeFile(dir + "/cpu.weight", QByteArray::number(_policy.cpuWeight));
+    writeFile(dir + "/memory.high", _policy.memoryHigh.toLatin1());
+    writeFile(dir + "/memory.max", _policy.memoryMax.toLatin1());
+}
+
+QString WMCGroup::leaf(const QString& wm) const
+{
+    return QString("%1/wm-%2").arg(_base).arg(wm);
+}
+
+QByteArray WMCGroup::procsFile(const QString& wm)
+{
+    if (!isActive()) return QByteArray();
+
+    QString dir = leaf(wm);
+    if (!QFileInfo(dir).isDir()) {
+        if (!QDir().mkpath(dir)) return QByteArray();
+        applyLimits(dir);
+    }
+
+    return QFile::encodeName(dir + "/cgroup.procs");
+}
+
+QHash<QString, qint64> WMCGroup::readKeyed(const QString& path)
+{
+    QHash<QString, qint64> kv;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) return kv;
+
+    for (const auto& ln: f.readAll().split('\n')) {
+        auto pair = ln.split(' ');
+        if (pair.size() == 2) {
+            kv[QString::fromLatin1(pair[0])] = pair[1].toLongLong();
+        }
+    }
+    return kv;
+}
+
+void WMCGroup::watch(const QString& wm)
+{
+    if (!isActive()) return;
+
+    if (!_watcher.files().isEmpty()) {
+        _watcher.removePaths(_watcher.files());
+    }
+
+    _watched = wm;
+    QString events = leaf(wm) + "/memory.events";
+    _lastEvents = readKeyed(events);
+    _highSince.invalidate();
+    _watcher.addPath(events);
+}
+
+QString WMCGroup::cpuStatFile(const QString& wm) const
+{
+    return isActive() ? leaf(wm) + "/cpu.stat" : QString();
+}
+
+void WMCGroup::onEventsChanged(const QString& path)
+{
+    auto events = readKeyed(path);
+    auto grown = [&](const char* key) {
+        return events.value(key) > _lastEvents.value(key);
+    };
+
+    QString reason;
+    if (grown("oom_kill")) {
+        reason = "oom_kill";
+    } else if (grown("oom") || grown("max")) {
+        reason = "memory.max";
+    } else if (grown("high")) {
+        // being throttled now and then is what memory.high is for,
+        // only a streak without long pauses counts.
+        if (!_highSince.isValid() || _lastHigh.elapsed() > HIGH_GRACE) {
+            _highSince.start();
+        } else if (_highSince.elapsed() > HIGH_GRACE) {
+            reason = "memory.high";
+        }
+        _lastHigh.start();
+    }
+
+    _lastEvents = events;
+    if (!reason.isEmpty()) {
+        wmm_warning() << _watched << "is over budget:" << reason;
+        _highSince.invalidate();
+        emit overBudget(_watched, reason);
+    }
+}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+struct CGroupPolicy {
+    bool enabled {false};
+    int cpuWeight {100};
+    // bytes or "max", as cgroup v2 accepts them
+    QString memoryHigh {"max"};
+    QString memoryMax {"max"};
+
+    static CGroupPolicy fromJson(const QJsonObject& obj);
+};
+
+/**
+ * QProcess which moves itself into a cgroup right after fork, so that
+ * the wm never runs outside of it.
+ */
+class CGroupProcess: public QProcess {
+    public:
+        void setCGroupProcsFile(const QByteArray& path) { _procsFile = path; }
+
+    protected:
+        void setupChildProcess() Q_DECL_OVERRIDE;
+
+    private:
+        QByteArray _procsFile;
+};
+
+/**
+ * Runs every wm in its own cgroup v2 leaf below the cgroup the switcher
+ * was started in:
+ *
+ *   <own cgroup>/switcher      the daemon itself
+ *   <own cgroup>/wm-<exec>     one per wm, with cpu/memory limits
+ *
+ * This needs the cpu and memory controllers delegated to us, e.g. by
+ * running as a systemd user service with Delegate=yes. Otherwise setup()
+ * fails and everything else is a no-op.
+ */
+class WMCGroup: public QObject {
+    Q_OBJECT
+    public:
+        explicit WMCGroup(QObject* parent = nullptr);
+
+        /**
+         * may be called again when the policy changes, the limits are
+         * written to the leaves which exist already as well
+         */
+        bool setup(const CGroupPolicy& policy);
+        bool isActive() const { return !_base.isEmpty(); }
+
+        /**
+         * cgroup.procs of wm's leaf, created on demand. empty if inactive.
+         */
+        QByteArray procsFile(const QString& wm);
+
+        /**
+         * watch memory.events of wm's leaf from now on
+         */
+        void watch(const QString& wm);
+
+        QString cpuStatFile(const QString& wm) const;
+
+    signals:
+        /**
+         * wm hit memory.max or got oom killed, or kept over memory.high
+         * for longer than HIGH_GRACE.
+         */
+        void overBudget(const QString& wm, const QString& reason);
+
+    private slots:
+        void onEventsChanged(const QString& path);
+
+    private:
+        const qint64 HIGH_GRACE = 30 * 1000;
+
+        CGroupPolicy _policy;
+        QString _base;
+        QString _watched;
+        QFileSystemWatcher _watcher;
+        QHash<QString, qint64> _lastEvents;
+        QElapsedTimer _highSince;
+        QElapsedTimer _lastHigh;
+
+        bool takeOver();
+        void applyLimits(const QString& dir);
+        QString leaf(const QString& wm) const;
+        QHash<QString, qint64> readKeyed(const QString& path);
+
+        static QString ownCGroup();
+        static bool writeFile(const QString& path, const QByteArray& data);
+};
+}
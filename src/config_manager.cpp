@@ -1,16 +1,72 @@
 #include "config.h"
 #include "config_manager.h"
+#include "metrics.h"
 
 namespace wmm {
 
-Config::Config() { load(); }
+static const char* const GLOBAL_CONFIG = "/etc/deepin-wm-switcher/config.json";
+
+class ConfigWriteTask: public QRunnable {
+    public:
+        ConfigWriteTask(const QString& path, const QByteArray& data, QAtomicInt* pending)
+            :_path(path), _data(data), _pending(pending) {}
+
+        void run() override {
+            write();
+            // after the rename, the reload it triggers reads our data
+            _pending->deref();
+        }
+
+    private:
+        QString _path;
+        QByteArray _data;
+        QAtomicInt* _pending;
+
+        void write() {
+            QFileInfo fi(_path);
+            if (!QDir().mkpath(fi.path())) {
+                wmm_warning() << "can not make config dir" << fi.path();
+                return;
+            }
+
+            // written to a temp file, which commit() syncs and renames
+            // over the old one, a crash never leaves a truncated config.
+            QSaveFile f(_path);
+            if (!f.open(QIODevice::WriteOnly) || f.write(_data) != _data.size() || !f.commit()) {
+                wmm_warning() << "can not save config:" << f.errorString();
+                return;
+            }
+            Metrics::instance().inc("wmm_config_writes_total");
+        }
+};
+
+Config::Config()
+{
+    _writer.setMaxThreadCount(1);
+    _saveTimer.setSingleShot(true);
+    _saveTimer.setInterval(SAVE_DELAY);
+    connect(&_saveTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    // editors and package managers touch files several times in a row
+    _reloadTimer.setSingleShot(true);
+    _reloadTimer.setInterval(RELOAD_DELAY);
+    connect(&_reloadTimer, SIGNAL(timeout()), this, SLOT(reload()));
+}
+
+Config::~Config()
+{
+    if (_saveTimer.isActive()) {
+        flush();
+    }
+    _writer.waitForDone();
+}
 
 void Config::load() 
 {
     if (_loaded) return;
     // global config
     {
-        QString gpath("/etc/deepin-wm-switcher/config.json");
+        QString gpath(GLOBAL_CONFIG);
         if (QFile::exists(gpath)) {
             _global = loadFrom(gpath);
             if (!_global.isEmpty()) {
@@ -33,6 +89,7 @@ void Config::load()
             if (!_jobj.isEmpty()) {
                 wmm_info() << "load config done";
             }
+            _written = QJsonDocument(_jobj).toJson();
         } else {
             wmm_warning() << "config path does not exists or can not be made.";
         }
@@ -41,39 +98,118 @@ void Config::load()
     _loaded = true;
 }
 
-QJsonObject Config::loadFrom(const QString& path)
+void Config::watch()
+{
+    if (_watcher) return;
+
+    // created only now, its inotify notifier needs the event dispatcher
+    // of a running application
+    _watcher = new QFileSystemWatcher(this);
+    connect(_watcher, SIGNAL(fileChanged(const QString&)), &_reloadTimer, SLOT(start()));
+    connect(_watcher, SIGNAL(directoryChanged(const QString&)), &_reloadTimer, SLOT(start()));
+    watchFiles();
+}
+
+void Config::watchFiles()
+{
+    if (!_watcher) return;
+
+    // a file replaced by rename drops out of the watcher, so directories
+    // are watched too and files are added back after each reload.
+    QStringList paths;
+    paths << GLOBAL_CONFIG << _path.absoluteFilePath();
+    for (const auto& path: paths) {
+        QFileInfo fi(path);
+        QString dir = fi.dir().exists() ? fi.path() : QFileInfo(fi.path()).path();
+        if (!_watcher->directories().contains(dir)) {
+            _watcher->addPath(dir);
+        }
+        if (fi.exists() && !_watcher->files().contains(path)) {
+            _watcher->addPath(path);
+        }
+    }
+}
+
+void Config::reload()
 {
+    bool ok = false;
+    auto global = loadFrom(GLOBAL_CONFIG, &ok);
+    if (!ok) global = _global;
+
+    // unsaved changes of our own win over what is on disk, and so do
+    // those still being written, a slow home may take longer than
+    // RELOAD_DELAY. the rename at the end triggers another reload.
+    auto user = _jobj;
+    if (!_saveTimer.isActive() && _pendingWrites.load() == 0) {
+        QByteArray data;
+        user = loadFrom(_path.absoluteFilePath(), &ok, &data);
+        if (!ok || data == _written) user = _jobj;
+    }
+
+    watchFiles();
+    if (global == _global && user == _jobj) {
+        return;
+    }
+
+    QString oldWM = currentWM();
+    bool oldAllow = allowSwitch();
+
+    wmm_info() << "config changed on disk, reload";
+    _global = global;
+    _jobj = user;
+    _written = QJsonDocument(_jobj).toJson();
+
+    emit reloaded();
+    if (currentWM() != oldWM || allowSwitch() != oldAllow) {
+        emit changed();
+    }
+}
+
+QJsonObject Config::loadFrom(const QString& path, bool* ok, QByteArray* data)
+{
+    if (ok) *ok = true;
+
     QFile f(path);
-    if (f.exists() && f.open(QIODevice::ReadOnly)) {
+    if (!f.exists()) {
+        return QJsonObject();
+    }
+
+    if (f.open(QIODevice::ReadOnly)) {
         QJsonParseError error;
-        auto doc = QJsonDocument::fromJson(f.readAll(), &error);
-        if (error.error != QJsonParseError::NoError) {
-            wmm_warning() << error.errorString();
+        auto content = f.readAll();
+        if (data) *data = content;
+        auto doc = QJsonDocument::fromJson(content, &error);
+        if (error.error == QJsonParseError::NoError) {
+            return doc.object();
         }
-
-        return doc.object();
+        wmm_warning() << path << error.errorString();
     }
 
+    // half written by an editor, most likely
+    if (ok) *ok = false;
     return QJsonObject();
 }
 
 bool Config::save() 
 {
-    QDir dir(_path.path());
-    if (!_path.exists() && !dir.mkpath(_path.path())) {
-        return false;
-    }
+    if (!_loaded) return false;
 
-    QFile f(_path.filePath());
-    if (f.open(QIODevice::WriteOnly)) {
-        QJsonDocument doc(_jobj);
-        f.write(doc.toJson());
-        f.flush();
-    } else {
-        wmm_warning() << "can not open config file to save";
+    _saveTimer.start();
+    return true;
+}
+
+void Config::flush()
+{
+    _saveTimer.stop();
+
+    auto data = QJsonDocument(_jobj).toJson();
+    if (data == _written) {
+        return;
     }
 
-    return true;
+    _written = data;
+    _pendingWrites.ref();
+    _writer.start(new ConfigWriteTask(_path.absoluteFilePath(), data, &_pendingWrites));
 }
 
 QString Config::currentWM() 
@@ -96,6 +232,18 @@ bool Config::allowSwitch()
     }
 }
 
+QJsonValue Config::value(const QString& key) const
+{
+    return _jobj.contains(key) ? _jobj.value(key) : _global.value(key);
+}
+
+int Config::probeTimeout()
+{
+    const int def = 5000;
+    int ms = value("probe_timeout").toInt(def);
+    return ms > 0 ? ms : def;
+}
+
 void Config::setAllowSwitch(bool val) 
 {
     _jobj["allow_switch"] = val;
@@ -2,12 +2,26 @@
 
 #include <QtCore>
 
+class TestConfig;
+
 namespace wmm {
 class Config: public QObject {
+    Q_OBJECT
+    friend class ::TestConfig;
     public:
         Config();
+        ~Config();
 
         void load(); 
+        /**
+         * reload the config files whenever they change on disk. call it
+         * once the application object exists.
+         */
+        void watch();
+        /**
+         * schedule a write of the user config. writes within SAVE_DELAY
+         * are coalesced and done on a worker thread.
+         */
         bool save();
         QString currentWM();
 
@@ -15,12 +29,55 @@ class Config: public QObject {
         void setAllowSwitch(bool val);
         void selectWM(const QString& wm);
 
+        /**
+         * deadline in ms for the whole hardware probing phase
+         */
+        int probeTimeout();
+
+        /**
+         * user setting of key, or the global one if user has none
+         */
+        QJsonValue value(const QString& key) const;
+
+    signals:
+        /**
+         * last_wm or allow_switch took a new effective value after one
+         * of the config files was changed by someone else
+         */
+        void changed();
+        /**
+         * any key took a new value after a config file was changed
+         */
+        void reloaded();
+
     private:
         QJsonObject _jobj;
         QJsonObject _global;
         QFileInfo _path;
         bool _loaded {false};
 
-        QJsonObject loadFrom(const QString& path);
+        const int SAVE_DELAY = 300;
+        QTimer _saveTimer;
+        // what is on disk, or queued to get there
+        QByteArray _written;
+        // a single thread keeps writes in order
+        QThreadPool _writer;
+        // writes queued or running on _writer
+        QAtomicInt _pendingWrites;
+
+        const int RELOAD_DELAY = 500;
+        QFileSystemWatcher* _watcher {nullptr};
+        QTimer _reloadTimer;
+
+        /**
+         * ok is false if the file exists but can not be read or parsed,
+         * data gets its content
+         */
+        QJsonObject loadFrom(const QString& path, bool* ok = nullptr, QByteArray* data = nullptr);
+        void watchFiles();
+
+    private slots:
+        void flush();
+        void reload();
 };
 }
@@ -0,0 +1,110 @@
+#include "config.h"
+#include "cpu_hog.h"
+
+#include <unistd.h>
+
+namespace wmm {
+
+CpuHogPolicy CpuHogPolicy::fromJson(const QJsonObject& obj)
+{
+    CpuHogPolicy p;
+    p.high = obj["high"].toInt(p.high);
+    p.low = qMin(obj["low"].toInt(p.low), p.high);
+    p.duration = qMax(obj["duration"].toInt(p.duration), 1);
+    p.interval = qMax(obj["interval"].toInt(p.interval), 1);
+    return p;
+}
+
+CpuHogDetector::CpuHogDetector(QObject* parent)
+    :QObject(parent)
+{
+    connect(&_timer, SIGNAL(timeout()), this, SLOT(sample()));
+}
+
+void CpuHogDetector::setPolicy(const CpuHogPolicy& policy)
+{
+    _policy = policy;
+    _timer.setInterval(_policy.interval * 1000);
+}
+
+void CpuHogDetector::watch(qint64 pid, const QString& cpuStat)
+{
+    _pid = pid;
+    _cpuStat = cpuStat;
+    _lastCpu = readCpuTime();
+    _wall.start();
+    _hotSince.invalidate();
+    _fired = false;
+    _timer.setInterval(_policy.interval * 1000);
+    _timer.start();
+}
+
+void CpuHogDetector::stop()
+{
+    _timer.stop();
+    _pid = 0;
+}
+
+qint64 CpuHogDetector::readCpuTime()
+{
+    if (!_cpuStat.isEmpty()) {
+        QFile f(_cpuStat);
+        if (f.open(QIODevice::ReadOnly)) {
+            // "usage_usec N" comes first
+            auto fields = f.readLine().trimmed().split(' ');
+            if (fields.value(0) == "usage_usec") {
+                return fields.value(1).toLongLong() * 1000;
+            }
+        }
+    }
+
+    QFile stat(QString("/proc/%1/stat").arg(_pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+
+    // unlike schedstat this is summed over all threads, where gl
+    // drivers like llvmpipe do their work.
+    // comm may contain spaces, fields are counted after the last ')'
+    auto data = stat.readAll();
+    auto fields = data.mid(data.lastIndexOf(')') + 2).split(' ');
+    // utime and stime are fields 14 and 15 of the whole line
+    if (fields.size() < 13) return -1;
+
+    static const long ticks = sysconf(_SC_CLK_TCK);
+    qint64 t = fields[11].toLongLong() + fields[12].toLongLong();
+    return t * 1000000000LL / ticks;
+}
+
+void CpuHogDetector::sample()
+{
+    qint64 cpu = readCpuTime();
+    qint64 wall = _wall.nsecsElapsed();
+    if (cpu < 0 || _lastCpu < 0 || wall <= 0) {
+        _lastCpu = cpu;
+        _wall.restart();
+        return;
+    }
+
+    int usage = (cpu - _lastCpu) * 100 / wall;
+    _lastCpu = cpu;
+    _wall.restart();
+
+    if (usage < _policy.high) {
+        // only an unbroken run of busy samples counts
+        _hotSince.invalidate();
+        if (usage < _policy.low) _fired = false;
+        return;
+    }
+
+    if (!_hotSince.isValid()) _hotSince.start();
+
+    if (!_fired && _hotSince.elapsed() >= _policy.duration * 1000LL) {
+        wmm_warning() << QString("pid %1 uses %2% cpu for %3s").arg(_pid)
+            .arg(usage).arg(_hotSince.elapsed() / 1000);
+        _fired = true;
+        emit hogDetected(_pid, usage);
+    }
+}
+
+}
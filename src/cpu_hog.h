@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+struct CpuHogPolicy {
+    // percent of one core
+    int high {90};
+    int low {50};
+    // seconds usage has to stay above high before we act
+    int duration {30};
+    // seconds between samples
+    int interval {5};
+
+    static CpuHogPolicy fromJson(const QJsonObject& obj);
+};
+
+/**
+ * Samples cpu time of a process from /proc at a low rate and reports it
+ * once it stays above policy.high for policy.duration. It will not fire
+ * again until usage drops below policy.low.
+ */
+class CpuHogDetector: public QObject {
+    Q_OBJECT
+    public:
+        explicit CpuHogDetector(QObject* parent = nullptr);
+
+        void setPolicy(const CpuHogPolicy& policy);
+        /**
+         * cpuStat: cpu.stat of the cgroup pid runs in, if any. it also
+         * accounts for children of pid.
+         */
+        void watch(qint64 pid, const QString& cpuStat = QString());
+        void stop();
+
+    signals:
+        void hogDetected(qint64 pid, int usage);
+
+    private slots:
+        void sample();
+
+    private:
+        CpuHogPolicy _policy;
+        QTimer _timer;
+        qint64 _pid {0};
+        QString _cpuStat;
+
+        QElapsedTimer _wall;
+        qint64 _lastCpu {-1};
+        // since when every sample was above high
+        QElapsedTimer _hotSince;
+        bool _fired {false};
+
+        /**
+         * cpu time used by pid in ns, or -1
+         */
+        qint64 readCpuTime();
+};
+}
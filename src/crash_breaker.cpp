@@ -0,0 +1,91 @@
+#include "config.h"
+#include "crash_breaker.h"
+
+namespace wmm {
+
+CrashBreaker::CrashBreaker(int baseDelay, QObject* parent)
+    :QObject(parent), _baseDelay(baseDelay), _rng(std::random_device()())
+{
+    _clock.start();
+
+    _coolDown.setSingleShot(true);
+    _coolDown.setInterval(COOL_DOWN);
+    connect(&_coolDown, &QTimer::timeout, [=]() {
+        wmm_info() << "crash breaker cooled down, try again";
+        setState(HalfOpen);
+        emit retry();
+    });
+}
+
+int CrashBreaker::recentCrashes(const QString& wm)
+{
+    auto& q = _crashes[wm];
+    qint64 now = _clock.elapsed();
+    while (!q.empty() && now - q.front() > CRASH_WINDOW) {
+        q.pop_front();
+    }
+    return q.size();
+}
+
+void CrashBreaker::recordCrash(const QString& wm)
+{
+    _crashes[wm].push_back(_clock.elapsed());
+    wmm_info() << wm << "crashed" << recentCrashes(wm) << "times recently";
+}
+
+void CrashBreaker::recordStable(const QString& wm)
+{
+    if (_state == HalfOpen) {
+        wmm_info() << wm << "is stable, close crash breaker";
+        setState(Closed);
+    }
+}
+
+int CrashBreaker::backoff(const QString& wm)
+{
+    int n = recentCrashes(wm);
+    qint64 delay = (qint64)_baseDelay << qMin(n, 16);
+    delay = qMin<qint64>(delay, MAX_DELAY);
+
+    // +-20% jitter
+    std::uniform_int_distribution<int> jitter(-delay / 5, delay / 5);
+    return qMax<int>(0, delay + jitter(_rng));
+}
+
+bool CrashBreaker::shouldTrip(const QString& wm)
+{
+    return _state == HalfOpen || recentCrashes(wm) >= CRASH_THRESHOLD;
+}
+
+void CrashBreaker::trip()
+{
+    wmm_warning() << "wm keeps crashing, stop respawning for" << COOL_DOWN / 1000 << "s";
+    setState(Open);
+    _coolDown.start();
+}
+
+void CrashBreaker::reset()
+{
+    _coolDown.stop();
+    _crashes.clear();
+    setState(Closed);
+}
+
+QString CrashBreaker::stateName() const
+{
+    switch (_state) {
+        case Closed: return "closed";
+        case Open: return "open";
+        case HalfOpen: return "half-open";
+    }
+    return QString();
+}
+
+void CrashBreaker::setState(State st)
+{
+    if (_state == st) return;
+    _state = st;
+    emit stateChanged(stateName());
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QtCore>
+#include <deque>
+#include <random>
+
+namespace wmm {
+/**
+ * Keeps crash history of every wm over a sliding window, computes the
+ * respawn backoff from it and stops respawning altogether when wms keep
+ * crashing right away.
+ *
+ * Closed: respawn with backoff. Open: give up until the cool down ends
+ * or someone resets it. HalfOpen: one more try, a crash reopens it and
+ * a stable run closes it.
+ */
+class CrashBreaker: public QObject {
+    Q_OBJECT
+    public:
+        enum State {
+            Closed,
+            Open,
+            HalfOpen,
+        };
+
+        explicit CrashBreaker(int baseDelay, QObject* parent = nullptr);
+
+        void recordCrash(const QString& wm);
+        /**
+         * wm has been running long enough to be considered healthy
+         */
+        void recordStable(const QString& wm);
+
+        /**
+         * ms to wait before spawning wm, exponential in its recent
+         * crashes and jittered so we do not respawn in lockstep.
+         */
+        int backoff(const QString& wm);
+
+        /**
+         * true if spawning wm now would just continue a crash loop
+         */
+        bool shouldTrip(const QString& wm);
+        void trip();
+        void reset();
+
+        State state() const { return _state; }
+        QString stateName() const;
+
+    signals:
+        void stateChanged(const QString& state);
+        /**
+         * cool down is over, caller may try to spawn again
+         */
+        void retry();
+
+    private:
+        // crashes older than this are forgotten
+        const qint64 CRASH_WINDOW = 60 * 1000;
+        // that many crashes in the window makes a crash loop
+        const int CRASH_THRESHOLD = 3;
+        const int MAX_DELAY = 30 * 1000;
+        const int COOL_DOWN = 5 * 60 * 1000;
+
+        int _baseDelay;
+        State _state {Closed};
+        QElapsedTimer _clock;
+        QTimer _coolDown;
+        QHash<QString, std::deque<qint64>> _crashes;
+        std::mt19937 _rng;
+
+        int recentCrashes(const QString& wm);
+        void setState(State st);
+};
+}
@@ -0,0 +1,69 @@
+#include "config.h"
+#include "exec_locator.h"
+
+namespace wmm {
+
+ExecutableLocator::ExecutableLocator(QObject* parent)
+    :QObject(parent)
+{
+    rearm();
+
+    connect(&_watcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(onChanged(const QString&)));
+    connect(&_watcher, SIGNAL(fileChanged(const QString&)), this, SLOT(onChanged(const QString&)));
+}
+
+QString ExecutableLocator::find(const QString& name)
+{
+    auto it = _cache.constFind(name);
+    if (it != _cache.constEnd()) {
+        return it.value();
+    }
+
+    QString path = QStandardPaths::findExecutable(name);
+    _cache.insert(name, path);
+    if (!path.isEmpty() && !_watcher.files().contains(path)) {
+        _watcher.addPath(path);
+    }
+    return path;
+}
+
+void ExecutableLocator::invalidate()
+{
+    _cache.clear();
+}
+
+void ExecutableLocator::rearm()
+{
+    // inotify on a dir reports attribute changes of its entries too, so
+    // a chmod -x is seen as well as installs and removals.
+    auto dirs = QString::fromLocal8Bit(qgetenv("PATH")).split(':', QString::SkipEmptyParts);
+    auto watched = _watcher.directories();
+    for (const auto& dir: watched) {
+        if (!dirs.contains(dir)) {
+            _watcher.removePath(dir);
+        }
+    }
+    for (const auto& dir: dirs) {
+        if (QFileInfo(dir).isDir() && !watched.contains(dir)) {
+            _watcher.addPath(dir);
+        }
+    }
+
+    // a binary replaced by rename is no longer watched
+    auto files = _watcher.files();
+    for (const auto& path: _cache) {
+        if (!path.isEmpty() && !files.contains(path) && QFileInfo(path).exists()) {
+            _watcher.addPath(path);
+        }
+    }
+}
+
+void ExecutableLocator::onChanged(const QString& path)
+{
+    wmm_debug() << path << "changed, forget located executables";
+    invalidate();
+    rearm();
+    emit changed();
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * QStandardPaths::findExecutable with a cache. The PATH dirs and every
+ * binary found are watched, any change there drops the cache and is
+ * reported by changed().
+ */
+class ExecutableLocator: public QObject {
+    Q_OBJECT
+    public:
+        explicit ExecutableLocator(QObject* parent = nullptr);
+
+        /**
+         * absolute path of name, empty if it is not installed
+         */
+        QString find(const QString& name);
+        void invalidate();
+
+        /**
+         * watch the dirs of PATH as it is now, those which did not
+         * exist before and any the watcher dropped included
+         */
+        void rearm();
+
+    signals:
+        void changed();
+
+    private slots:
+        void onChanged(const QString& path);
+
+    private:
+        // misses are cached as well
+        QHash<QString, QString> _cache;
+        QFileSystemWatcher _watcher;
+};
+}
@@ -0,0 +1,264 @@
+#include "config.h"
+#include "frame_pacing.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <xcb/damage.h>
+#include <xcb/randr.h>
+
+namespace wmm {
+
+FramePacingPolicy FramePacingPolicy::fromJson(const QJsonObject& obj)
+{
+    FramePacingPolicy p;
+    p.high = obj["high"].toInt(p.high);
+    p.low = qMin(obj["low"].toInt(p.low), p.high);
+    p.duration = qMax(obj["duration"].toInt(p.duration), 1);
+    p.interval = qMax(obj["interval"].toInt(p.interval), 1);
+    p.window = qMax(obj["window"].toInt(p.window), 1);
+    p.minFrames = qMax(obj["min_frames"].toInt(p.minFrames), 1);
+    p.minRun = qMax(obj["min_run"].toInt(p.minRun), 2);
+    p.maxFrame = qMax(obj["max_frame"].toInt(p.maxFrame), 1);
+    p.idleGap = qMax(obj["idle_gap"].toInt(p.idleGap), 1);
+    return p;
+}
+
+FramePacingMonitor::FramePacingMonitor(QObject* parent)
+    :QObject(parent)
+{
+    connect(&_timer, SIGNAL(timeout()), this, SLOT(evaluate()));
+}
+
+FramePacingMonitor::~FramePacingMonitor()
+{
+    stop();
+}
+
+void FramePacingMonitor::setPolicy(const FramePacingPolicy& policy)
+{
+    _policy = policy;
+    _timer.setInterval(_policy.interval * 1000);
+}
+
+void FramePacingMonitor::watch(const QString& display)
+{
+    stop();
+
+    int screen = 0;
+    _conn = xcb_connect(display.isEmpty() ? nullptr : display.toLatin1().constData(), &screen);
+    if (xcb_connection_has_error(_conn)) {
+        wmm_warning() << "frame pacing: can not connect to display" << display;
+        xcb_disconnect(_conn);
+        _conn = nullptr;
+        return;
+    }
+
+    auto* ext = xcb_get_extension_data(_conn, &xcb_damage_id);
+    auto* version = ext && ext->present ? xcb_damage_query_version_reply(_conn,
+            xcb_damage_query_version(_conn, XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION), NULL) : nullptr;
+    if (!version) {
+        wmm_warning() << "frame pacing: no DAMAGE extension";
+        xcb_disconnect(_conn);
+        _conn = nullptr;
+        return;
+    }
+    free(version);
+
+    auto it = xcb_setup_roots_iterator(xcb_get_setup(_conn));
+    for (int i = 0; i < screen && it.rem; i++) {
+        xcb_screen_next(&it);
+    }
+
+    // one notify per frame: it comes when the damage turns non empty,
+    // and we empty it again right after
+    _damageNotify = ext->first_event + XCB_DAMAGE_NOTIFY;
+    _damage = xcb_generate_id(_conn);
+    xcb_damage_create(_conn, _damage, it.data->root, XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+    xcb_flush(_conn);
+
+    _refresh = refreshInterval(it.data->root);
+    wmm_debug() << "frame pacing: refresh interval" << _refresh << "ms";
+
+    _notifier = new QSocketNotifier(xcb_get_file_descriptor(_conn), QSocketNotifier::Read, this);
+    connect(_notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+
+    _clock.start();
+    _lastFrame = -1;
+    _frames.clear();
+    _run.clear();
+    _animating = false;
+    _stall = 0;
+    _slowSince = -1;
+    _fired = false;
+    _timer.setInterval(_policy.interval * 1000);
+    _timer.start();
+}
+
+void FramePacingMonitor::stop()
+{
+    _timer.stop();
+    if (_notifier) {
+        // we may be inside its activated()
+        _notifier->setEnabled(false);
+        _notifier->deleteLater();
+        _notifier = nullptr;
+    }
+    if (_conn) {
+        xcb_disconnect(_conn);
+        _conn = nullptr;
+    }
+}
+
+void FramePacingMonitor::readEvents()
+{
+    bool painted = false;
+    xcb_generic_event_t* ev;
+    while ((ev = xcb_poll_for_event(_conn))) {
+        painted = painted || (ev->response_type & ~0x80) == _damageNotify;
+        free(ev);
+    }
+
+    if (xcb_connection_has_error(_conn)) {
+        wmm_warning() << "frame pacing: lost connection to x server";
+        stop();
+        return;
+    }
+
+    if (painted) {
+        onFrame();
+        xcb_damage_subtract(_conn, _damage, XCB_NONE, XCB_NONE);
+        xcb_flush(_conn);
+    }
+}
+
+double FramePacingMonitor::refreshInterval(xcb_window_t root)
+{
+    const double fallback = 1000.0 / 60;
+
+    auto* ext = xcb_get_extension_data(_conn, &xcb_randr_id);
+    if (!ext || !ext->present) return fallback;
+
+    auto* res = xcb_randr_get_screen_resources_current_reply(_conn,
+            xcb_randr_get_screen_resources_current(_conn, root), NULL);
+    if (!res) return fallback;
+
+    auto* modes = xcb_randr_get_screen_resources_current_modes(res);
+    int nmodes = xcb_randr_get_screen_resources_current_modes_length(res);
+    auto* crtcs = xcb_randr_get_screen_resources_current_crtcs(res);
+    int ncrtcs = xcb_randr_get_screen_resources_current_crtcs_length(res);
+
+    // a compositor syncing to one of several outputs is never faster
+    // than the slowest of them
+    double interval = 0;
+    for (int i = 0; i < ncrtcs; i++) {
+        auto* crtc = xcb_randr_get_crtc_info_reply(_conn,
+                xcb_randr_get_crtc_info(_conn, crtcs[i], res->config_timestamp), NULL);
+        if (!crtc) continue;
+
+        for (int j = 0; j < nmodes && crtc->mode != XCB_NONE; j++) {
+            const auto& m = modes[j];
+            if (m.id != crtc->mode || !m.dot_clock || !m.htotal || !m.vtotal) continue;
+            interval = qMax(interval, 1000.0 * m.htotal * m.vtotal / m.dot_clock);
+        }
+        free(crtc);
+    }
+    free(res);
+
+    // Xvfb and some drivers report no usable mode
+    return interval > 0 ? interval : fallback;
+}
+
+void FramePacingMonitor::onFrame()
+{
+    qint64 now = _clock.elapsed();
+    if (_lastFrame < 0) {
+        _lastFrame = now;
+        return;
+    }
+
+    double interval = now - _lastFrame;
+    _lastFrame = now;
+
+    if (interval > qMax(_refresh * 1.5, double(_policy.maxFrame))) {
+        _stall = _animating && interval <= _policy.idleGap ? interval : 0;
+        _run.clear();
+        _animating = false;
+        return;
+    }
+
+    if (_animating) {
+        record(now, interval);
+        return;
+    }
+
+    _run.push_back(interval);
+    if (int(_run.size()) < _policy.minRun) return;
+
+    // a new animation, the gap before it was a stall of the last one
+    if (_stall > 0) {
+        record(now, _stall);
+        _stall = 0;
+    }
+    for (double i: _run) {
+        record(now, i);
+    }
+    _run.clear();
+    _animating = true;
+}
+
+void FramePacingMonitor::record(qint64 at, double interval)
+{
+    // vblanks gone by without a frame, in stalls and slow runs alike
+    int missed = qRound(interval / _refresh) - 1;
+    if (missed > 0) {
+        Metrics::instance().inc("wmm_frames_missed_total", QString(), missed);
+    }
+    _frames.push_back(qMakePair(at, interval));
+}
+
+double FramePacingMonitor::p95() const
+{
+    if (int(_frames.size()) < _policy.minFrames) return -1;
+
+    std::vector<double> intervals;
+    intervals.reserve(_frames.size());
+    for (const auto& f: _frames) {
+        intervals.push_back(f.second);
+    }
+
+    auto nth = intervals.begin() + (intervals.size() * 95 / 100);
+    std::nth_element(intervals.begin(), nth, intervals.end());
+    return *nth;
+}
+
+void FramePacingMonitor::evaluate()
+{
+    qint64 now = _clock.elapsed();
+    while (!_frames.empty() && now - _frames.front().first > _policy.window * 1000LL) {
+        _frames.pop_front();
+    }
+
+    // an idle screen breaks a slow streak, but does not re-arm
+    double p = p95();
+    if (p < 0) {
+        _slowSince = -1;
+        return;
+    }
+
+    Metrics::instance().observe("wmm_frame_time_p95_ms", QString(), qint64(p));
+
+    if (p >= _policy.high) {
+        if (_slowSince < 0) _slowSince = now;
+
+        if (!_fired && now - _slowSince >= _policy.duration * 1000LL) {
+            wmm_warning() << QString("p95 frame time %1ms for %2s").arg(p).arg((now - _slowSince) / 1000);
+            _fired = true;
+            emit janky(p);
+        }
+    } else if (p < _policy.low) {
+        _slowSince = -1;
+        _fired = false;
+    }
+}
+
+}
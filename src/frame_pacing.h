@@ -0,0 +1,105 @@
+#pragma once
+
+#include <deque>
+
+#include <QtCore>
+#include <xcb/xcb.h>
+
+namespace wmm {
+struct FramePacingPolicy {
+    // p95 frame time in ms
+    int high {50};
+    int low {33};
+    // seconds p95 has to stay above high before we act
+    int duration {10};
+    // seconds between evaluations
+    int interval {1};
+    // seconds of frames the percentile is taken over, and the least
+    // number of frames in there to judge at all
+    int window {5};
+    int minFrames {30};
+    // back to back frames which make an animation, and the most ms
+    // between two of them. a software rendered wm painting at 15fps
+    // animates, a blinking cursor does not. never below 1.5 refreshes.
+    int minRun {6};
+    int maxFrame {80};
+    // ms without a frame that end an animation rather than stall it
+    int idleGap {1000};
+
+    static FramePacingPolicy fromJson(const QJsonObject& obj);
+};
+
+/**
+ * Estimates frame times of the compositor from X Damage on the root
+ * window: whatever gets painted on screen damages the root again once
+ * we subtracted the last damage.
+ *
+ * Only animations are judged, that is runs of policy.minRun frames at
+ * most policy.maxFrame ms apart, so a compositor which is steadily slow
+ * counts as well as one that hitches. A gap is a stall if an animation
+ * runs on both sides of it, however long it is up to policy.idleGap.
+ * A clock or a cursor updating at its own pace never makes such a run
+ * and is left alone.
+ *
+ * p95 of the intervals judged in the last policy.window seconds is
+ * reported by janky() once it stays above policy.high for
+ * policy.duration, and not again until it drops below policy.low.
+ *
+ * It uses a connection of its own, a busy screen does not load the
+ * event queue of Qt.
+ */
+class FramePacingMonitor: public QObject {
+    Q_OBJECT
+    public:
+        explicit FramePacingMonitor(QObject* parent = nullptr);
+        ~FramePacingMonitor();
+
+        void setPolicy(const FramePacingPolicy& policy);
+        /**
+         * display is like ":1", empty for $DISPLAY
+         */
+        void watch(const QString& display = QString());
+        void stop();
+
+        /**
+         * of the last window, -1 if there are too few frames
+         */
+        double p95() const;
+
+    signals:
+        void janky(double p95);
+
+    private slots:
+        void readEvents();
+        void evaluate();
+
+    private:
+        FramePacingPolicy _policy;
+        QTimer _timer;
+
+        xcb_connection_t* _conn {nullptr};
+        quint32 _damage {0};
+        quint8 _damageNotify {0};
+        QSocketNotifier* _notifier {nullptr};
+
+        // ms between vblanks, of the slowest output
+        double _refresh {1000.0 / 60};
+
+        QElapsedTimer _clock;
+        qint64 _lastFrame {-1};
+        // (ms since _clock started, interval in ms)
+        std::deque<QPair<qint64, double>> _frames;
+        // intervals of a run too short to be an animation yet
+        std::vector<double> _run;
+        bool _animating {false};
+        // gap after the last animation, judged if another one follows
+        double _stall {0};
+
+        qint64 _slowSince {-1};
+        bool _fired {false};
+
+        void onFrame();
+        void record(qint64 at, double interval);
+        double refreshInterval(xcb_window_t root);
+};
+}
@@ -0,0 +1,119 @@
+#include "config.h"
+#include "gpu_inventory.h"
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <xcb/dri3.h>
+
+namespace wmm {
+
+// "major:minor" of a drm node
+static QByteArray readDev(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return f.read(64).trimmed();
+}
+
+GpuInventory::GpuInventory(HardwareProbe& probe)
+    :_probe(probe)
+{
+}
+
+void GpuInventory::setXConnection(xcb_connection_t* conn, xcb_window_t root)
+{
+    QMutexLocker locker(&_lock);
+    _conn = conn;
+    _root = root;
+}
+
+QByteArray GpuInventory::xDeviceNumber()
+{
+    if (!_conn) return QByteArray();
+
+    auto* ext = xcb_get_extension_data(_conn, &xcb_dri3_id);
+    if (!ext || !ext->present) {
+        wmm_info() << "no DRI3, can not tell which gpu X uses";
+        return QByteArray();
+    }
+
+    auto* version = xcb_dri3_query_version_reply(_conn,
+            xcb_dri3_query_version(_conn, XCB_DRI3_MAJOR_VERSION, XCB_DRI3_MINOR_VERSION), NULL);
+    if (!version) return QByteArray();
+    free(version);
+
+    // provider 0 is the one the screen is rendered with
+    auto* reply = xcb_dri3_open_reply(_conn, xcb_dri3_open(_conn, _root, 0), NULL);
+    if (!reply) return QByteArray();
+
+    QByteArray number;
+    if (reply->nfd == 1) {
+        int fd = xcb_dri3_open_reply_fds(_conn, reply)[0];
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISCHR(st.st_mode)) {
+            number = QByteArray::number(major(st.st_rdev)) + ':' + QByteArray::number(minor(st.st_rdev));
+        }
+        close(fd);
+    }
+    free(reply);
+    return number;
+}
+
+const QList<GpuDevice>& GpuInventory::devices()
+{
+    QMutexLocker locker(&_lock);
+    if (_loaded) return _devices;
+    _loaded = true;
+
+    _devices = _probe.gpus();
+
+    // the server may hand out either the card or the render node
+    QByteArray xdev = xDeviceNumber();
+    if (!xdev.isEmpty()) {
+        for (auto& gpu: _devices) {
+            for (const auto& node: {gpu.card, gpu.renderNode}) {
+                if (!node.isEmpty() && readDev(_probe.sysPath("class/drm/" + node + "/dev")) == xdev) {
+                    gpu.usedByX = true;
+                }
+            }
+        }
+    }
+
+    for (const auto& gpu: _devices) {
+        wmm_info() << "gpu" << gpu.slot << QString("%1:%2").arg(gpu.vendor_id).arg(gpu.dev_id)
+            << gpu.driver << gpu.card << gpu.renderNode
+            << (gpu.enabled ? "enabled" : "disabled")
+            << (gpu.bootVga ? "boot_vga" : "") << (gpu.usedByX ? "used by X" : "");
+    }
+
+    return _devices;
+}
+
+const GpuDevice* GpuInventory::primary(const QList<GpuDevice>& devices)
+{
+    const GpuDevice* boot = nullptr;
+    const GpuDevice* first = nullptr;
+    for (const auto& gpu: devices) {
+        if (gpu.usedByX) return &gpu;
+        if (!gpu.enabled || gpu.card.isEmpty()) continue;
+
+        if (!boot && gpu.bootVga) boot = &gpu;
+        if (!first) first = &gpu;
+    }
+
+    return boot ? boot : first;
+}
+
+bool GpuInventory::isHybrid(const QList<GpuDevice>& devices)
+{
+    int n = 0;
+    for (const auto& gpu: devices) {
+        if (gpu.enabled && !gpu.card.isEmpty()) n++;
+    }
+    return n > 1;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QtCore>
+#include <xcb/xcb.h>
+
+#include "hw_probe.h"
+
+namespace wmm {
+/**
+ * The drm devices HardwareProbe found, and which of them the X server
+ * renders with, as told by DRI3. On
+ * hybrid machines this tells the gpu driving the screen apart from an
+ * idle discrete one.
+ *
+ * Thread safe, the scan is done once.
+ */
+class GpuInventory {
+    public:
+        explicit GpuInventory(HardwareProbe& probe);
+
+        /**
+         * X server asked when devices are first listed, none by default
+         */
+        void setXConnection(xcb_connection_t* conn, xcb_window_t root);
+
+        const QList<GpuDevice>& devices();
+
+        /**
+         * the device X uses, else the boot vga one, else the first
+         * enabled one. nullptr if there is none.
+         */
+        static const GpuDevice* primary(const QList<GpuDevice>& devices);
+        /**
+         * more than one enabled device with a card node
+         */
+        static bool isHybrid(const QList<GpuDevice>& devices);
+
+    private:
+        HardwareProbe& _probe;
+        xcb_connection_t* _conn {nullptr};
+        xcb_window_t _root {XCB_NONE};
+
+        QMutex _lock;
+        bool _loaded {false};
+        QList<GpuDevice> _devices;
+
+        /**
+         * "major:minor" of the node DRI3 hands out, the form of the
+         * dev attribute in sysfs. empty if unknown.
+         */
+        QByteArray xDeviceNumber();
+};
+}
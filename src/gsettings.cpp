@@ -0,0 +1,70 @@
+// gio has members named signals, it has to come before Qt
+#include <gio/gio.h>
+
+#include "config.h"
+#include "gsettings.h"
+
+namespace wmm {
+
+bool gsettings_set(const QString& schema, const QString& key, const QString& value)
+{
+    GSettingsSchemaSource* source = g_settings_schema_source_get_default();
+    // g_settings_new() aborts on a missing schema, look it up first
+    GSettingsSchema* s = source ? g_settings_schema_source_lookup(
+            source, schema.toUtf8().constData(), TRUE) : nullptr;
+    if (!s) {
+        wmm_warning() << "no such schema" << schema;
+        return false;
+    }
+
+    bool ok = false;
+    QByteArray k = key.toUtf8();
+    if (g_settings_schema_has_key(s, k.constData())) {
+        GSettingsSchemaKey* sk = g_settings_schema_get_key(s, k.constData());
+        GError* error = nullptr;
+        GVariant* v = g_variant_parse(g_settings_schema_key_get_value_type(sk),
+                value.toUtf8().constData(), nullptr, nullptr, &error);
+        if (v) {
+            GSettings* settings = g_settings_new_full(s, nullptr, nullptr);
+            // takes the floating reference of v
+            ok = g_settings_set_value(settings, k.constData(), v);
+            g_settings_sync();
+            g_object_unref(settings);
+        } else {
+            wmm_warning() << QString("%1 %2: %3").arg(schema).arg(key).arg(error->message);
+            g_error_free(error);
+        }
+        g_settings_schema_key_unref(sk);
+    } else {
+        wmm_warning() << schema << "has no key" << key;
+    }
+
+    g_settings_schema_unref(s);
+    return ok;
+}
+
+class GSettingsWriteTask: public QRunnable {
+    public:
+        GSettingsWriteTask(const QString& schema, const QString& key, const QString& value)
+            :_schema(schema), _key(key), _value(value) {}
+
+        void run() override {
+            bool ok = gsettings_set(_schema, _key, _value);
+            wmm_info() << "gsettings set" << _schema << _key << _value << (ok ? "done" : "failed");
+        }
+
+    private:
+        QString _schema;
+        QString _key;
+        QString _value;
+};
+
+void gsettings_set_async(const QString& schema, const QString& key, const QString& value)
+{
+    // waits for queued writes on exit
+    static QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start(new GSettingsWriteTask(schema, key, value));
+}
+
+}
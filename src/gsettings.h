@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * set key of schema through GSettings in process, value is in GVariant
+ * text form like `gsettings set` takes it. false if the schema or key
+ * is not installed or value does not parse.
+ */
+bool gsettings_set(const QString& schema, const QString& key, const QString& value);
+
+/**
+ * gsettings_set on a worker thread, since g_settings_sync() blocks
+ * until dconf has the value. writes are done in the order queued.
+ */
+void gsettings_set_async(const QString& schema, const QString& key, const QString& value);
+}
@@ -0,0 +1,44 @@
+#include "config.h"
+#include "histogram.h"
+
+#include <algorithm>
+
+namespace wmm {
+
+const QList<qint64>& Histogram::bounds()
+{
+    static const QList<qint64> b = {
+        10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000
+    };
+    return b;
+}
+
+Histogram::Histogram()
+    :_counts(bounds().size() + 1, 0)
+{
+}
+
+void Histogram::observe(qint64 ms)
+{
+    const auto& b = bounds();
+    int i = std::lower_bound(b.cbegin(), b.cend(), ms) - b.cbegin();
+    _counts[i]++;
+    _count++;
+    _sum += ms;
+}
+
+QVariantMap Histogram::toVariantMap() const
+{
+    QVariantList le, counts;
+    for (auto v: bounds()) le << v;
+    for (auto v: _counts) counts << v;
+
+    QVariantMap m;
+    m["le"] = le;
+    m["counts"] = counts;
+    m["count"] = _count;
+    m["sum"] = _sum;
+    return m;
+}
+
+}
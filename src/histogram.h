@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * Latency histogram in ms with fixed, roughly exponential buckets.
+ */
+class Histogram {
+    public:
+        Histogram();
+
+        void observe(qint64 ms);
+
+        /**
+         * upper bounds of all buckets but the last, which is +Inf
+         */
+        static const QList<qint64>& bounds();
+        const QVector<quint64>& counts() const { return _counts; }
+        quint64 count() const { return _count; }
+        qint64 sum() const { return _sum; }
+
+        QVariantMap toVariantMap() const;
+
+    private:
+        QVector<quint64> _counts;
+        quint64 _count {0};
+        qint64 _sum {0};
+};
+}
@@ -0,0 +1,203 @@
+#include "config.h"
+#include "hw_probe.h"
+
+#include <sys/utsname.h>
+
+namespace wmm {
+
+HardwareProbe::HardwareProbe(const QString& sysRoot, const QString& procRoot)
+    :_sysRoot(sysRoot), _procRoot(procRoot)
+{
+}
+
+QString HardwareProbe::sysPath(const QString& rel) const
+{
+    return QString("%1/%2").arg(_sysRoot).arg(rel);
+}
+
+QString HardwareProbe::procPath(const QString& rel) const
+{
+    return QString("%1/%2").arg(_procRoot).arg(rel);
+}
+
+QByteArray HardwareProbe::readSmallFile(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    // sysfs attributes report a size of 4096 regardless of content, so
+    // do not trust size() here.
+    return f.read(4096).trimmed();
+}
+
+const QList<PciDevice>& HardwareProbe::pciDevices()
+{
+    QMutexLocker locker(&_pciLock);
+    if (_pciLoaded) return _pci;
+    _pciLoaded = true;
+
+    QDir dir(sysPath("bus/pci/devices"));
+    auto entries = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const auto& slot: entries) {
+        QString base = dir.filePath(slot);
+
+        PciDevice dev;
+        dev.slot = slot;
+        // attributes look like "0x030000\n"
+        auto hex = [&](const char* attr) {
+            return QString::fromLatin1(readSmallFile(base + "/" + attr)).remove("0x").toLower();
+        };
+        dev.klass = hex("class").toUInt(nullptr, 16);
+        dev.vendor_id = hex("vendor");
+        dev.dev_id = hex("device");
+
+        QFileInfo drv(base + "/driver");
+        if (drv.isSymLink()) {
+            dev.driver = QFileInfo(drv.symLinkTarget()).fileName();
+        }
+
+        _pci.append(dev);
+    }
+
+    return _pci;
+}
+
+QList<PciDevice> HardwareProbe::videoCards()
+{
+    QList<PciDevice> cards;
+    for (const auto& dev: pciDevices()) {
+        if (dev.isVGA() || dev.is3D()) {
+            cards.append(dev);
+        }
+    }
+
+    return cards;
+}
+
+void HardwareProbe::loadUname()
+{
+    QMutexLocker locker(&_unameLock);
+    if (_unameLoaded) return;
+    _unameLoaded = true;
+
+    struct utsname uts;
+    if (uname(&uts) == 0) {
+        _machine = QString::fromLatin1(uts.machine);
+        _release = QString::fromLatin1(uts.release);
+    } else {
+        wmm_warning() << "uname failed";
+    }
+}
+
+QString HardwareProbe::machine()
+{
+    loadUname();
+    return _machine;
+}
+
+QString HardwareProbe::kernelRelease()
+{
+    loadUname();
+    return _release;
+}
+
+const QSet<QString>& HardwareProbe::modules()
+{
+    QMutexLocker locker(&_modulesLock);
+    if (_modulesLoaded) return _modules;
+    _modulesLoaded = true;
+
+    QFile f(procPath("modules"));
+    if (!f.open(QIODevice::ReadOnly)) {
+        wmm_warning() << "can not open " << f.fileName();
+        return _modules;
+    }
+
+    // name size refcount deps state address
+    auto lines = f.readAll().split('\n');
+    for (const auto& ln: lines) {
+        int sp = ln.indexOf(' ');
+        if (sp > 0) {
+            _modules.insert(QString::fromLatin1(ln.left(sp)));
+        }
+    }
+
+    return _modules;
+}
+
+bool HardwareProbe::hasModule(const QString& name)
+{
+    return modules().contains(name);
+}
+
+const QList<GpuDevice>& HardwareProbe::gpus()
+{
+    QMutexLocker locker(&_drmLock);
+    if (_drmLoaded) return _gpus;
+    _drmLoaded = true;
+
+    // sysfs prints pci ids as 0x8086
+    auto pciId = [](const QString& path) {
+        auto id = readSmallFile(path);
+        return id.startsWith("0x") ? QString::fromLatin1(id.mid(2)).toLower() : QString();
+    };
+
+    // nodes of a device link to the same sysfs dir. connectors show
+    // up as card0-HDMI-A-1 and alike, skip them.
+    QDir dir(sysPath("class/drm"));
+    auto entries = dir.entryList(QStringList() << "card*" << "renderD*",
+            QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    QHash<QString, int> index;
+    for (const auto& node: entries) {
+        if (node.contains('-')) continue;
+
+        QString base = dir.filePath(node) + "/device";
+        QString real = QFileInfo(base).canonicalFilePath();
+        if (real.isEmpty()) continue;
+
+        if (!index.contains(real)) {
+            GpuDevice gpu;
+            gpu.slot = QFileInfo(real).fileName();
+            gpu.vendor_id = pciId(base + "/vendor");
+            gpu.dev_id = pciId(base + "/device");
+
+            QFileInfo drv(base + "/driver");
+            if (drv.isSymLink()) {
+                gpu.driver = QFileInfo(drv.symLinkTarget()).fileName();
+            }
+
+            // only pci devices have enable, on shenwei it may not be
+            // readable by group/other and is not counted then. nouveau
+            // writes 2, others 1.
+            gpu.enabled = !QFile::exists(base + "/enable") || readSmallFile(base + "/enable").toInt() > 0;
+            gpu.bootVga = readSmallFile(base + "/boot_vga") == "1";
+
+            index.insert(real, _gpus.size());
+            _gpus.append(gpu);
+        }
+
+        GpuDevice& gpu = _gpus[index[real]];
+        if (node.startsWith("card")) {
+            gpu.card = node;
+        } else {
+            gpu.renderNode = node;
+        }
+    }
+
+    return _gpus;
+}
+
+QStringList HardwareProbe::drmDrivers()
+{
+    QStringList drivers;
+    for (const auto& gpu: gpus()) {
+        if (gpu.enabled && !gpu.card.isEmpty() && !gpu.driver.isEmpty()) {
+            drivers.append(gpu.driver);
+        }
+    }
+    return drivers;
+}
+
+}
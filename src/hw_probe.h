@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+namespace PciVendor {
+    const quint16 Intel       = 0x8086;
+    const quint16 ATI         = 0x1002;
+    const quint16 Nvidia      = 0x10de;
+    const quint16 VirtualBox  = 0x80ee;
+    const quint16 VMWare      = 0x15ad;
+}
+
+struct PciDevice {
+    QString slot;
+    quint32 klass {0};
+    // lower case 4 digits hex, the same form as `lspci -nn` prints
+    QString vendor_id;
+    QString dev_id;
+    // name of bound kernel driver, empty if none
+    QString driver;
+
+    quint16 vendor() const { return vendor_id.toUShort(nullptr, 16); }
+    bool isVGA() const { return (klass >> 8) == 0x0300; }
+    bool is3D() const { return (klass >> 8) == 0x0302; }
+};
+
+struct GpuDevice {
+    // sysfs name of the device, the pci slot for pci gpus
+    QString slot;
+    // lower case 4 digits hex, empty for non pci devices
+    QString vendor_id;
+    QString dev_id;
+    QString driver;
+    // like card0 and renderD128, empty if the device has no such node
+    QString card;
+    QString renderNode;
+    bool enabled {false};
+    // initialized by the firmware, the display at boot
+    bool bootVga {false};
+    // X renders with it, only known when the server has DRI3
+    bool usedByX {false};
+
+    quint16 vendor() const { return vendor_id.toUShort(nullptr, 16); }
+    quint32 pciId() const { return quint32(vendor()) << 16 | dev_id.toUShort(nullptr, 16); }
+};
+
+/**
+ * Reads hardware facts straight from sysfs, procfs and uname(2) instead
+ * of forking lspci, lsmod and friends. Every source is read at most once
+ * and the result is shared by all rules. Roots can be redirected so that
+ * a fake tree can be used for testing.
+ *
+ * All accessors are thread safe, rules may probe concurrently.
+ */
+class HardwareProbe {
+    public:
+        HardwareProbe(const QString& sysRoot = "/sys", const QString& procRoot = "/proc");
+
+        const QList<PciDevice>& pciDevices();
+        /**
+         * vga or 3d controllers, matches what `lspci` lists as video cards
+         */
+        QList<PciDevice> videoCards();
+
+        QString machine();
+        QString kernelRelease();
+
+        const QSet<QString>& modules();
+        bool hasModule(const QString& name);
+
+        /**
+         * every drm device with its card and render nodes, in node
+         * order. usedByX is left for GpuInventory to fill in.
+         */
+        const QList<GpuDevice>& gpus();
+        /**
+         * kernel drivers of enabled drm cards, in card order
+         */
+        QStringList drmDrivers();
+
+        QString sysPath(const QString& rel) const;
+        QString procPath(const QString& rel) const;
+
+    private:
+        QString _sysRoot;
+        QString _procRoot;
+
+        QMutex _pciLock;
+        bool _pciLoaded {false};
+        QList<PciDevice> _pci;
+
+        QMutex _unameLock;
+        bool _unameLoaded {false};
+        QString _machine;
+        QString _release;
+
+        QMutex _modulesLock;
+        bool _modulesLoaded {false};
+        QSet<QString> _modules;
+
+        QMutex _drmLock;
+        bool _drmLoaded {false};
+        QList<GpuDevice> _gpus;
+
+        void loadUname();
+        static QByteArray readSmallFile(const QString& path);
+};
+}
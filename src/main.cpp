@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <memory>
 
 #include <QtGlobal>
 #include <QtGui>
@@ -24,9 +25,10 @@
 #include <xcb/xcb_keysyms.h>
 
 #include "config.h"
-#include "config_manager.h"
-
-#define C2Q(cs) (QString::fromUtf8((cs).c_str()))
+#include "window_manager.h"
+#include "rules.h"
+#include "monitor.h"
+#include "metrics.h"
 
 using namespace std;
 
@@ -88,33 +90,6 @@ static unsigned GetModifier( xcb_connection_t *p_connection, xcb_key_symbols_t *
 #endif
 
 namespace wmm {
-    struct WindowManager {
-        string genericName;
-        string execName;
-        QProcessEnvironment env;
-    };
-
-    using WindowManagerList = vector<WindowManager>;
-
-    WindowManagerList wms = {
-        {"deepin wm", "deepin-wm", {}},
-        {"deepin metacity", "deepin-metacity", {}},
-    };
-
-    enum SwitchingPermission {
-        ALLOW_NONE,
-        ALLOW_TO_2D,
-        ALLOW_TO_3D,
-        ALLOW_BOTH
-    };
-
-    using WMPointer = WindowManagerList::iterator;
-
-    static WMPointer good_wm = wms.begin();
-    static WMPointer bad_wm = wms.begin() + 1;
-    static SwitchingPermission  switch_permission = ALLOW_NONE;
-
-    static WindowManagerList::iterator apply_rules();
 
 #if USE_BUILTIN_KEYBINDING
     class MyShortcutManager: public QObject, public QAbstractNativeEventFilter {
@@ -226,810 +201,33 @@ namespace wmm {
 
             const QString currentWM() const;
 
-        signals:
-            void toggleWM();
-            void wmChanged();
-
-        private:
-            WindowManagerMonitor *_parent;
-    };
-
-#endif
-
-
-    class NotifyHelper: public QObject {
-        Q_OBJECT
-        public:
-            void notifyStart3D() { osd("SwitchWM3D"); }
-
-            void notifyStart2D() { osd("SwitchWM2D"); }
-
-            void notify3DError() { osd("SwitchWMError"); }
-
-        private:
-            void osd(QString name) {
-                QDBusInterface ifce("com.deepin.dde.osd",
-                                     "/",
-                                     "com.deepin.dde.osd");
-                ifce.asyncCall("ShowOSD", name);
-            }
-    };
-
-    struct Card {
-        QString vendor_id;
-        QString dev_id;
-    };
-    bool operator==(const Card& self, const Card &other) {
-        return self.vendor_id == other.vendor_id && self.dev_id == other.dev_id;
-    }
-
-    QDebug operator<<(QDebug debug, const Card &c) {
-        QDebugStateSaver saver(debug);
-        debug.nospace() << "[" << c.vendor_id << ":" << c.dev_id << "]";
-        return debug;
-    }
-
-    class Settings: public QObject {
-        public:
-            Settings() {
-                QString config_base = QStandardPaths::writableLocation(
-                        QStandardPaths::ConfigLocation);
-                if (config_base.isEmpty()) {
-                    config_base = QString("%1/.config").arg(QDir::homePath());
-                }
-
-                _cfgFilePath = QString("%1/deepin/deepin-wm-switcher/cards.ini").arg(config_base);
-
-                auto l2 = loadEnv();
-                if (_cfgFilePath.exists()) {
-                    auto l1 = loadSettings();
-                    _changed = l1 != l2;
-                }
-                saveSettings(l2);
-            }
-            
-            bool isCardsChanged() const { return _changed; }
-
-        private:
-            QFileInfo _cfgFilePath;
-            bool _changed {false};
-			
-
-            void saveSettings(const QList<Card>& cards) {
-                QSettings cfg(_cfgFilePath.filePath(), QSettings::NativeFormat);
-                cfg.clear();
-                cfg.beginWriteArray("cards");
-                for (int i = 0; i < cards.size(); ++i) {
-                    cfg.setArrayIndex(i);
-                    cfg.setValue("vendor_id", cards[i].vendor_id);
-                    cfg.setValue("dev_id", cards[i].dev_id);
-                }
-                cfg.endArray();
-                qDebug() << "save cards" << cards;
-                cfg.sync();
-            }
-
-            QList<Card> loadSettings() {
-                QList<Card> cards;
-
-                QSettings cfg(_cfgFilePath.filePath(), QSettings::NativeFormat);
-                int size = cfg.beginReadArray("cards");
-                for (int i = 0; i < size; ++i) {
-                    cfg.setArrayIndex(i);
-                    Card c;
-                    c.vendor_id = cfg.value("vendor_id").toString();
-                    c.dev_id = cfg.value("dev_id").toString();
-                    cards.append(c);
-                }
-                cfg.endArray();
-
-                qDebug() << "load cards" << cards;
-                return cards;
-            }
-
-            QList<Card> loadEnv() {
-                QList<Card> cards;
-
-                QString data;
-                QProcess lspci;
-                lspci.start("lspci -nn");
-                if (lspci.waitForStarted() && lspci.waitForFinished()) {
-                    data = QString::fromUtf8(lspci.readAllStandardOutput());
-                }
-
-                QStringList vcards;
-                QRegExp re_vcard(" (vga|3d).*(display|graphics|controller)", Qt::CaseInsensitive);
-                QRegExp re_ids("\\[(\\w{4}):(\\w{4})\\]", Qt::CaseInsensitive);
-                QStringList sl = data.split("\n");
-                for (const auto& s: sl) {
-                    if (re_vcard.indexIn(s) != -1) {
-                        re_ids.indexIn(s);
-                        cards.append({re_ids.cap(1), re_ids.cap(2)});
-                    }
-                }
-
-                wmm_info() << "found cards" << cards;
-                return cards;
-            }
-    };
-
-
-    static Settings global_settings;
-    static Config global_config;
-    class Rule {
-        public:
             /**
-             * do some test and may change supported wm
+             * closed, open or half-open
              */
-            virtual void doTest(WMPointer base) = 0;
+            const QString circuitBreakerState() const;
+            void resetCircuitBreaker();
+
             /**
-             * wm that this Rule recommends most
+             * ms from request to each phase of the last switch
              */
-            virtual WMPointer getSupport() = 0;
+            QVariantMap lastSwitchLatency() const;
             /**
-             * some changes needed in the environment
+             * per phase latency histograms of switches to wm, a ladder id
+             * like "deepin-wm" as in the wm_ladder config
              */
-            virtual QProcessEnvironment additionalEnv() {
-                return QProcessEnvironment();
-            }
-    };
-
-    class PlatformChecker: public Rule {
-        public:
-            void doTest(WMPointer base) override {
-                _voted = base;
-
-                QProcess uname;
-                uname.start("uname -m");
-                switch_permission = ALLOW_BOTH;
-                if (uname.waitForStarted()) {
-                    if (uname.waitForFinished()) {
-                        auto data = uname.readAllStandardOutput();
-                        string machine(data.trimmed().constData());
-                        wmm_info() << QString("machine: %1").arg(machine.c_str());
-
-                        QRegExp re("x86.*|i?86|ia64", Qt::CaseInsensitive);
-                        if (re.indexIn(C2Q(machine)) != -1) {
-                            wmm_info() << "match x86";
-                            _voted = good_wm;
-
-                        } else if (machine.find("alpha") != string::npos
-                                || machine.find("sw_64") != string::npos) {
-                            // shenwei
-                            wmm_info() << "match shenwei";
-                            _voted = bad_wm;
-
-                            _envs.insert("META_DEBUG_NO_SHADOW", "1");
-                            _envs.insert("META_IDLE_PAINT_MODE", "fixed");
-                            _envs.insert("META_IDLE_PAINT_FPS", "28");
-                            reduce_animations(true);
-
-                        } else if (machine.find("mips") != string::npos) { // loongson
-                            wmm_info() << "match loongson";
-                            //TODO: may need to check graphics card
-                            _voted = good_wm;
-
-                        } else if (machine.find("arm") != string::npos) { // arm
-                            wmm_info() << "match arm";
-                            _voted = good_wm;
-                        }
-                    }
-                }
-            }
-
-            WMPointer getSupport() override {
-                return _voted;
-            }
-
-            QProcessEnvironment additionalEnv() override {
-                return _envs;
-            }
-
-        private:
-            WMPointer _voted { wms.end() };
-            QProcessEnvironment _envs {};
-
-            void reduce_animations(bool val) {
-                QString cmd("gsettings set com.deepin.wrap.gnome.metacity reduced-resources %1");
-                QProcess proc;
-                proc.start(val ? cmd.arg("true") : cmd.arg("false"));
-                if (proc.waitForStarted() && proc.waitForFinished()) {
-                    wmm_info() << "set reduce_animations " << (val? "true" : "false") << " done";
-                }
-            }
-    };
-
-    class EnvironmentChecker: public Rule {
-        public:
-            struct VideoEnv {
-                static const int Unknown     = 0;
-                static const int Intel       = 0x0001;
-                static const int AMD         = 0x0002;
-                static const int Nvidia      = 0x0004;
-                static const int VirtualBox  = 0x0100;
-                static const int VMWare      = 0x0200;
-            };
-
-            void doTest(WMPointer base) override {
-                _voted = base;
-
-                if (!isDriverLoadedCorrectly()) {
-                    _voted = bad_wm;
-                    return;
-                }
-
-                QString data;
-                QProcess lspci;
-                lspci.start("lspci");
-                if (lspci.waitForStarted() && lspci.waitForFinished()) {
-                    data = QString::fromUtf8(lspci.readAllStandardOutput());
-                }
-
-                _video = VideoEnv::Unknown;
-
-                static QRegExp vbox("vga.* virtualbox", Qt::CaseInsensitive);
-                static QRegExp vmware("vga.* vmware", Qt::CaseInsensitive);
-                static QRegExp intel("(vga|3d).* intel", Qt::CaseInsensitive);
-                static QRegExp amd("(vga|3d).* ati", Qt::CaseInsensitive);
-                static QRegExp nvidia("(vga|3d).* nvidia", Qt::CaseInsensitive);
-
-                if (vbox.indexIn(data) != -1) {
-                    _video |= VideoEnv::VirtualBox;
-                } else if (vmware.indexIn(data) != -1) {
-                    _video |= VideoEnv::VMWare;
-                } else if (intel.indexIn(data) != -1) {
-                    _video |= VideoEnv::Intel;
-                } else if (amd.indexIn(data) != -1) {
-                    _video |= VideoEnv::AMD;
-                } else if (nvidia.indexIn(data) != -1) {
-                    _video |= VideoEnv::Nvidia;
-                }
-
-                string msg = "video env:";
-                if (_video & VideoEnv::VirtualBox) msg += " VirtualBox";
-                if (_video & VideoEnv::VMWare) msg += " VMWare";
-                if (_video & VideoEnv::Intel) msg += " Intel";
-                if (_video & VideoEnv::AMD) msg += " AMD";
-                if (_video & VideoEnv::Nvidia) msg += " Nvidia";
-                wmm_info() << msg.c_str();
-
-                QProcess lsmod;
-                lsmod.start("/sbin/lsmod");
-                if (lsmod.waitForStarted() && lsmod.waitForFinished()) {
-                    data = QString::fromUtf8(lsmod.readAllStandardOutput());
-                }
-
-                //FIXME: check dual video cards and detect which is in use
-                //by Xorg now.
-                if (_video == VideoEnv::AMD && data.contains("fglrx")) {
-                    if (_voted == good_wm) {
-                        _envs.insert("COGL_DRIVER", "gl");
-                    }
-                } else if (_video == VideoEnv::Nvidia && data.contains("nvidia")) {
-                    //TODO: still need to test and verify
-                } else if (_video == VideoEnv::VirtualBox && !data.contains("vboxvideo")) {
-                    _voted = bad_wm;
-                } else if (_video == VideoEnv::VMWare && !data.contains("vmwgfx")) {
-                    _voted = bad_wm;
-                }
-            }
-
-            WMPointer getSupport() override {
-                return _voted;
-            }
-
-            QProcessEnvironment additionalEnv() override {
-                return _envs;
-            }
-
-        private:
-            WMPointer _voted { wms.end() };
-            int _video {VideoEnv::Unknown};
-            QProcessEnvironment _envs;
-
-            bool isDriverLoadedCorrectly() {
-                static QRegExp aiglx_err("\\(EE\\)\\s+AIGLX error");
-                static QRegExp dri_ok("direct rendering: DRI\\d+ enabled");
-                static QRegExp swrast("GLX: Initialized DRISWRAST");
-
-                QString xorglog = QString("/var/log/Xorg.%1.log").arg(QX11Info::appScreen());
-                wmm_info() << "check " << xorglog;
-                QFile f(xorglog);
-                if (!f.open(QFile::ReadOnly)) {
-                    wmm_warning() << "can not open " << xorglog;
-                    return false;
-                }
-
-                QTextStream ts(&f);
-                while (!ts.atEnd()) {
-                    QString ln = ts.readLine();
-                    if (aiglx_err.indexIn(ln) != -1) {
-                        wmm_info() << "found aiglx error";
-                        return false;
-                    }
-
-                    if (dri_ok.indexIn(ln) != -1) {
-                        wmm_info() << "dri enabled successfully";
-                        return true;
-                    }
-
-                    if (swrast.indexIn(ln) != -1) {
-                        wmm_info() << "swrast driver used";
-                        return false;
-                    }
-                }
-
-                return true;
-            }
-    };
-
-	class PlatformOverrideChecker: public Rule {
-		public:
-			void doTest(WMPointer base) override {
-				_voted = base;
-                QProcess uname;
-                uname.start("uname -m");
-                if (uname.waitForStarted() && uname.waitForFinished()) {
-                    auto data = uname.readAllStandardOutput();
-                    string machine(data.trimmed().constData());
-                    wmm_info() << QString("machine: %1").arg(machine.c_str());
-
-                    if (machine.find("alpha") != string::npos
-                            || machine.find("sw_64") != string::npos) {
-                        if (is_radeon_exists()) {
-                            _voted = good_wm;
-                            wmm_info() << QString("override wm on shenwei: %1 -> %2")
-                                .arg(C2Q(base->genericName)).arg(C2Q(_voted->genericName));
-                        } else {
-                            wmm_info() << QString("no radeon card, disallow switch");
-                            switch_permission = ALLOW_NONE;
-                        }
-                    }
-                }
-			}
-
-			WMPointer getSupport() override {
-				return _voted;
-			}
-
-			QProcessEnvironment additionalEnv() override {
-				return _envs;
-			}
-
-		private:
-			WMPointer _voted { wms.end() };
-			QProcessEnvironment _envs;
-
-			bool is_device_viable(int id) {
-				char path[128];
-				snprintf(path, sizeof path, "/sys/class/drm/card%d", id);
-				if (access(path, F_OK) != 0) {
-					return false;
-				}
-
-                //OK, on shenwei, this file may have no read permission for group/other.
-				char buf[512];
-				snprintf(buf, sizeof buf, "%s/device/enable", path);
-                if (access(buf, R_OK) == 0) {
-                    FILE* fp = fopen(buf, "r");
-                    if (!fp) {
-                        return false;
-                    }
-
-                    int enabled = 0;
-                    fscanf(fp, "%d", &enabled);
-                    fclose(fp);
-
-                    // nouveau write 2, others 1
-                    return enabled > 0;
-                }
-
-                return false;
-			}
-
-			bool is_card_exists(const vector<string>& vs, const vector<string>& drivers) {
-				for (auto card: vs) {
-					char buf[1024] = {0};
-					int id = std::stoi(card.substr(card.size()-1));
-					snprintf(buf, sizeof buf, "/sys/class/drm/card%d/device/driver", id);
-
-					char buf2[1024] = {0};
-					if (readlink(buf, buf2, sizeof buf2) < 0) {
-                        return false;
-                    }
-
-					string driver = basename(buf2);
-                    wmm_info() << "test driver: " << C2Q(driver);
-                    if (std::any_of(drivers.cbegin(), drivers.cend(), [=](string s) {
-                                return s == driver;
-                            })) {
-						return true;
-					} 
-				}
-
-				return false;
-			}
-
-            bool dri_is_radeon() {
-                QProcess xdriinfo;
-                xdriinfo.start("xdriinfo driver 0");
-                if (xdriinfo.waitForStarted() && xdriinfo.waitForFinished()) {
-                    string drv(xdriinfo.readAllStandardOutput().trimmed().constData());
-
-                    wmm_info() << "drm info is unreadable, try xdriinfo: " << C2Q(drv);
-                    vector<string> dris {"r600", "r300", "r200", "radeon"};
-                    if (std::any_of(dris.cbegin(), dris.cend(), [=](string s) {
-                                return s == drv;
-                            })) {
-                        return true;
-                    } 
-                }
-                return false;
-            }
-
-            bool is_radeon_exists() {
-                wmm_info() << "checking radeon card";
-                vector<string> viables;
-                string card = "/dev/dri/card0";
-                const char* const tmpl = "/dev/dri/card%d";
-                for (int i = 0; i < 4; i++) {
-                    char buf[128];
-                    snprintf(buf, 127, tmpl, i);
-                    if (is_device_viable(i)) {
-                        viables.push_back(buf);
-                    }
-                }
-
-                if (viables.size() > 0) {
-                    vector<string> drivers = {"radeon", "fglrx", "amdgpu"};
-                    return is_card_exists(viables, drivers);
-                } else {
-                    return dri_is_radeon();
-                }
-
-            }
-	};
-
-    class ConfigChecker: public Rule {
-        public:
-            void doTest(WMPointer base) override {
-                _voted = base;
-                global_config.load();
-
-                // if cards list changed, use probed result instead of config
-                // (which might be stale at this moment).
-                if (global_settings.isCardsChanged()) {
-                    wmm_info() << "detect cards changed, ignore config";
-                    global_config.selectWM(C2Q(_voted->execName));
-                    global_config.setAllowSwitch(switch_permission != ALLOW_NONE);
-                    return;
-                }
-
-                QString saved = global_config.currentWM();
-                if (!global_config.allowSwitch()) {
-                    switch_permission = ALLOW_NONE;
-                }
-                if (saved == C2Q(good_wm->execName)) {
-                    _voted = good_wm;
-                } else if (saved == C2Q(bad_wm->execName)) {
-                    _voted = bad_wm;
-                }
-            }
-
-            WMPointer getSupport() override {
-                return _voted;
-            }
-
-        private:
-            WMPointer _voted { wms.end() };
-    };
-
-    struct ActionInterface {
-        virtual void on_good_wm() = 0;
-        virtual void on_bad_wm() = 0;
-        virtual string name() = 0;
-    };
-
-    class SogouAction: public ActionInterface {
-        public:
-            void on_good_wm () override {
-                if (!_currentSkin.isEmpty()) {
-                    setSkin(_currentSkin.toStdString());
-                    QProcess::execute("killall sogou-qimpanel");
-                }
-            }
-
-            void on_bad_wm () override {
-                saveSkin();
-                setSkin("默认皮肤");
-                QProcess::execute("killall sogou-qimpanel");
-            }
-
-            string name() override {
-                return "update sogou skin";
-            }
-
-        private:
-            QString _currentSkin;
-
-            void setSkin(const string& skin) {
-                QFile f(QDir::homePath() + QString::fromUtf8("/.config/sogou-qimpanel/main.conf"));
-                if (!f.open(QIODevice::ReadWrite)) {
-                    wmm_warning() << __func__ << "conf open failed";
-                    return;
-                }
-
-                QVector<QString> data;
-
-                QTextStream ts(&f);
-                while (!ts.atEnd()) {
-                    QString l = ts.readLine();
-                    if (l.startsWith("CurtSogouSkinType")) {
-                        l = QString("CurtSogouSkinType=%1").arg(C2Q(skin));
-                        wmm_info() << "replace skin: " << l;
-                    }
-                    data.push_back(l);
-                }
-
-                f.close();
-
-                f.open(QIODevice::Truncate|QIODevice::WriteOnly);
-                for (auto& l: data) {
-                    ts << l << endl;
-                }
-            }
-
-            void saveSkin() {
-                QFile f(QDir::homePath() + QString::fromUtf8("/.config/sogou-qimpanel/main.conf"));
-                if (!f.open(QIODevice::ReadOnly)) {
-                    wmm_warning() << __func__ << "conf open failed";
-                    return;
-                }
-
-                QTextStream ts(&f);
-                while (!ts.atEnd()) {
-                    QString l = ts.readLine();
-                    if (l.startsWith("CurtSogouSkinType")) {
-                        _currentSkin = l.replace("CurtSogouSkinType=", "");
-                        wmm_info() << "save current skin: " << _currentSkin;
-                        break;
-                    }
-                }
-            }
-    };
-
-    class WindowManagerMonitor: public QObject {
-        Q_OBJECT
-        public:
-            void start(const WindowManagerList::iterator& init_wm) {
-                _voted = init_wm;
-
-                _current = _voted;
-                wmm_info() << QString("exec wm %1").arg(C2Q(_current->genericName));
-
-                _actions.emplace_back(new SogouAction());
-
-                spawn();
-
-                QTimer::singleShot(CHECK_PERIOD, this, SLOT(onTimeout()));
-            }
-
-            const QString currentWM() const {
-                return C2Q(_current->genericName);
-            }
-
-            virtual ~WindowManagerMonitor() {
-                if (_proc) delete _proc;
-            }
+            QVariantMap switchLatencyHistogram(const QString& wm) const;
 
         signals:
-            void onWMChanged();
-
-        public slots:
-            void onToggleWM() {
-                if (!allowSwitch()) return;
-
-                WMPointer old = _current;
-                if (old == bad_wm) {
-                    _current = good_wm;
-                    _requestedNotify = &NotifyHelper::notifyStart3D;
-                } else if (old == good_wm) {
-                    _current = bad_wm;
-                    _requestedNotify = &NotifyHelper::notifyStart2D;
-                } else {
-                    return;
-                }
-
-                if (_current != wms.end())
-                    global_config.selectWM(C2Q(_current->execName));
-
-                spawn();
-            }
+            void toggleWM();
+            void wmChanged();
+            void circuitBreakerChanged(const QString& state);
 
         private:
-            WMPointer _current { wms.end() };
-            WMPointer _voted { wms.end() };
-            QProcess* _proc {nullptr};
-            vector<ActionInterface*> _actions;
-            NotifyHelper _notify;
-            int _spawnCount {0};
-
-            using NotifyRequest = void (NotifyHelper::*)();
-            NotifyRequest _requestedNotify {nullptr};
-
-            const int CHECK_PERIOD = 1000;
-            const int STARTUP_DELAY = 500;
-            const int NOTIFY_DELAY = 600;
-            const int KILL_TIMEOUT = 3000;
-
-            bool allowSwitch() {
-                wmm_debug() << __func__ << "switch_permission = " << switch_permission;
-                switch (switch_permission) {
-                    case ALLOW_NONE: {
-                        return false;
-                    }
-                    case ALLOW_BOTH: break;
-                    case ALLOW_TO_2D: if (_current == bad_wm) return false;
-                    case ALLOW_TO_3D: if (_current == good_wm) return false;
-                }
-
-                return true;
-            }
-
-            void doSanityCheck() {
-                auto old = _current;
-                bool changed = false;
-
-                QString s = QString::fromUtf8(qgetenv("PATH"));
-                QString cmd = QStandardPaths::findExecutable(C2Q(good_wm->execName));
-                QFileInfo fi_good(cmd);
-
-                cmd = QStandardPaths::findExecutable(C2Q(bad_wm->execName));
-                QFileInfo fi_bad(cmd);
-
-                if (_current == good_wm) {
-                    if (!fi_good.exists() || !fi_good.isExecutable()) {
-                        _current = bad_wm;
-                        if (!fi_bad.exists() || !fi_bad.isExecutable()) {
-                            _current = wms.end();
-                        }
-                        changed = true;
-                    }
-
-                } else if (_current == bad_wm) {
-                    if (!fi_bad.exists() || !fi_bad.isExecutable()) {
-                        _current = good_wm;
-                        if (!fi_good.exists() || !fi_good.isExecutable()) {
-                            _current = wms.end();
-                        }
-                        changed = true;
-                    }
-
-                }
-
-                if (changed) {
-                    wmm_warning() << QString("%1: %2 -> %3").arg(__func__)
-                        .arg(old != wms.end() ? old->genericName.c_str() : "")
-                        .arg(_current != wms.end() ? _current->genericName.c_str() : "");
-                    _requestedNotify = nullptr;
-                }
-            }
-
-        private slots:
-            void spawn() {
-                QProcess* prev_proc = _proc;
-                if (prev_proc && prev_proc->state() == QProcess::Running) {
-                    wmm_warning() << QString("%1 is running, force it to terminate").arg(prev_proc->program());
-                    prev_proc->disconnect();
-                }
-
-                _proc = new QProcess;
-
-                doSanityCheck();
-                if (_current == wms.end()) return;
-
-                auto sys_env = QProcessEnvironment::systemEnvironment();
-                sys_env.insert(_current->env);
-                sys_env.insert("GDK_SCALE", "1");
-
-                connect(_proc, SIGNAL(finished(int, QProcess::ExitStatus)),
-                            this, SLOT(onWMProcFinished(int, QProcess::ExitStatus)));
-                _proc->setProcessEnvironment(sys_env);
-                _proc->start(C2Q(_current->execName), QStringList() << "--replace");
-
-                emit onWMChanged();
-
-                if (!_proc->waitForStarted(STARTUP_DELAY)) {
-                    wmm_warning() << QString("%1 start failed").arg(_proc->program());
-                    if (switch_permission != ALLOW_BOTH && _current == good_wm) {
-                        _requestedNotify = &NotifyHelper::notify3DError;
-                    }
-                }
-
-                do_post_actions(_current);
-
-                delete prev_proc;
-
-                QTimer::singleShot(NOTIFY_DELAY, this, SLOT(onDelayedNotify()));
-                _spawnCount++;
-            }
-
-            void do_post_actions(WMPointer current) {
-                if (current == good_wm) {
-                    wmm_info() << __func__ << "on good wm";
-                    for (auto *act: _actions) {
-                        wmm_info() << __func__ << C2Q(act->name());
-                        act->on_good_wm();
-                    }
-                } else if (current == bad_wm) {
-                    wmm_info() << __func__ << "on bad wm";
-                    for (auto *act: _actions) {
-                        wmm_info() << __func__ << C2Q(act->name());
-                        act->on_bad_wm();
-                    }
-                }
-            }
-
-            void onDelayedNotify() {
-                if (_requestedNotify != nullptr) {
-                    (_notify.*_requestedNotify)();
-                    _requestedNotify = nullptr;
-                }
-            }
-
-            void onWMProcFinished(int exitCode, QProcess::ExitStatus status) {
-                wmm_info() << __func__ << ": exitCode = " << exitCode;
-
-                if (status == QProcess::CrashExit || exitCode != 0) {
-                    wmm_warning() << QString("%1 crashed or failure, switch wm").arg(_proc->program());
-                    _requestedNotify = &NotifyHelper::notify3DError;
-                    if (allowSwitch()) {
-                        _current = _current == good_wm ? bad_wm: good_wm;
-                    }
-                }
-
-                QTimer::singleShot(STARTUP_DELAY, this, SLOT(spawn()));
-            }
-
-            void onTimeout() {
-                if (_current == wms.end()) {
-                    wmm_warning() << "there is no wm running currently, try launch one";
-                    _current = _voted;
-                    spawn();
-                }
-
-                QTimer::singleShot(CHECK_PERIOD, this, SLOT(onTimeout()));
-            }
-
+            WindowManagerMonitor *_parent;
     };
 
+#endif
 
-    static WindowManagerList::iterator apply_rules() {
-        vector<Rule*> rules = {
-            new PlatformChecker(),
-            new EnvironmentChecker(),
-            new PlatformOverrideChecker(),
-            new ConfigChecker(),
-        };
-
-        good_wm->env.clear();
-        bad_wm->env.clear();
-
-        WindowManagerList::iterator p = good_wm;
-        for (auto& rule: rules) {
-            rule->doTest(p);
-            p = rule->getSupport();
-            if (p != wms.end()) {
-                p->env.insert(rule->additionalEnv());
-            }
-        }
-
-        if (p == wms.end()) {
-            p = good_wm;
-        }
-
-        return p;
-    }
 
     // must after WindowManagerMonitor definition
     MyRemoteRequestHandler::MyRemoteRequestHandler(WindowManagerMonitor *parent)
@@ -1037,12 +235,37 @@ namespace wmm {
           _parent(parent)
     {
         connect(_parent, &WindowManagerMonitor::onWMChanged, this, &MyRemoteRequestHandler::toggleWM);
+        connect(&_parent->breaker(), &CrashBreaker::stateChanged,
+                this, &MyRemoteRequestHandler::circuitBreakerChanged);
     }
 
     const QString MyRemoteRequestHandler::currentWM() const
     {
         return _parent->currentWM();
     }
+
+    const QString MyRemoteRequestHandler::circuitBreakerState() const
+    {
+        return _parent->breaker().stateName();
+    }
+
+    QVariantMap MyRemoteRequestHandler::lastSwitchLatency() const
+    {
+        return _parent->switchTimer().last();
+    }
+
+    QVariantMap MyRemoteRequestHandler::switchLatencyHistogram(const QString& wm) const
+    {
+        return _parent->switchTimer().histograms(wm);
+    }
+
+    void MyRemoteRequestHandler::resetCircuitBreaker()
+    {
+        if (_parent->breaker().state() == CrashBreaker::Open) {
+            _parent->breaker().reset();
+            QMetaObject::invokeMethod(_parent, "spawn", Qt::QueuedConnection);
+        }
+    }
 }
 
 
@@ -1051,6 +274,12 @@ using namespace wmm;
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
+    Metrics::instance().exportTo();
+
+    // wm pointers are taken from here on
+    global_config.load();
+    global_config.watch();
+    wmm::load_ladder(global_config.value("wm_ladder").toArray());
 
 #if USE_BUILTIN_KEYBINDING
     wmm::MyShortcutManager xcbFilter;
@@ -1070,20 +299,50 @@ int main(int argc, char *argv[])
     conn.registerObject("/com/deepin/wm_switcher", &wmMonitor);
 #endif
 
+    // so is the memory and cpu of the machine, all displays toggle
+    // on the same pressure watcher
+    wmm::PressureWatcher pressure;
+    auto pressureCfg = global_config.value("pressure").toObject();
+    if (pressureCfg["enabled"].toBool(true) && !pressure.start(wmm::PressurePolicy::fromJson(pressureCfg))) {
+        wmm_warning() << "pressure is not watched";
+    }
+    wmMonitor.setPressureWatcher(&pressure);
+
+    // hardware is the same for every display, probe it once
     auto p = wmm::apply_rules();
     wmMonitor.start(p);
 
-    if (global_config.allowSwitch()) {
+    // more X displays or screens to supervise, like ":1" or ":0.1"
+    QString own = QString::fromLocal8Bit(qgetenv("DISPLAY"));
+    for (const auto& v: global_config.value("displays").toArray()) {
+        QString display = v.toString();
+        if (display.isEmpty() || display == own || display == own + ".0") continue;
+
+        auto* m = new wmm::WindowManagerMonitor(display, &app);
+        m->setPressureWatcher(&pressure);
+#if !USE_BUILTIN_KEYBINDING
+        auto* adaptor = new wmm::MyRemoteRequestHandler(m);
+        QObject::connect(adaptor, SIGNAL(wmChanged()), m, SLOT(onToggleWM()));
+        // ":1.0" -> /com/deepin/wm_switcher/display_1_0
+        QString path = QString("/com/deepin/wm_switcher/display_%1")
+            .arg(QString(display).remove(':').replace('.', '_'));
+        if (!conn.registerObject(path, m)) {
+            wmm_warning() << "register" << path << "failed";
+        }
+#endif
+        m->start(p);
+    }
+
+    // allow_switch may change at runtime, onToggleWM checks it
 #if USE_BUILTIN_KEYBINDING
-        QObject::connect(&xcbFilter, SIGNAL(toggleWM()), &wmMonitor, SLOT(onToggleWM()));
+    QObject::connect(&xcbFilter, SIGNAL(toggleWM()), &wmMonitor, SLOT(onToggleWM()));
 #else
-        QObject::connect(&dobj, SIGNAL(wmChanged()), &wmMonitor, SLOT(onToggleWM()));
+    QObject::connect(&dobj, SIGNAL(wmChanged()), &wmMonitor, SLOT(onToggleWM()));
 #endif
-    }
 
     app.exec();
 
     return 0;
 }
 
-#include "main.moc"
+#include "main.moc"
\ No newline at end of file
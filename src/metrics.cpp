@@ -0,0 +1,122 @@
+#include "config.h"
+#include "metrics.h"
+
+namespace wmm {
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics()
+{
+    _flushTimer = new QTimer(this);
+    _flushTimer->setSingleShot(true);
+    _flushTimer->setInterval(FLUSH_DELAY);
+    connect(_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+void Metrics::exportTo(const QString& path)
+{
+    _path = path;
+    if (_path.isEmpty()) {
+        QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+        if (runtime.isEmpty()) return;
+        _path = QString("%1/deepin-wm-switcher/metrics.prom").arg(runtime);
+    }
+
+    QDir().mkpath(QFileInfo(_path).path());
+    flush();
+}
+
+QString Metrics::label(const QString& key, const QString& value)
+{
+    QString v = value;
+    v.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+    return QString("%1=\"%2\"").arg(key).arg(v);
+}
+
+void Metrics::inc(const QString& name, const QString& labels, quint64 n)
+{
+    {
+        QMutexLocker locker(&_lock);
+        _counters[name][labels] += n;
+    }
+    changed();
+}
+
+void Metrics::observe(const QString& name, const QString& labels, qint64 ms)
+{
+    {
+        QMutexLocker locker(&_lock);
+        _histograms[name][labels].observe(ms);
+    }
+    changed();
+}
+
+void Metrics::changed()
+{
+    // may be called from any thread, the timer lives in ours
+    QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+}
+
+void Metrics::scheduleFlush()
+{
+    if (!_path.isEmpty() && !_flushTimer->isActive()) {
+        _flushTimer->start();
+    }
+}
+
+QByteArray Metrics::exposition() const
+{
+    QMutexLocker locker(&_lock);
+    QByteArray out;
+    QTextStream ts(&out);
+
+    auto braced = [](const QString& labels) {
+        return labels.isEmpty() ? QString() : QString("{%1}").arg(labels);
+    };
+
+    for (auto it = _counters.cbegin(); it != _counters.cend(); ++it) {
+        ts << "# TYPE " << it.key() << " counter\n";
+        for (auto l = it->cbegin(); l != it->cend(); ++l) {
+            ts << it.key() << braced(l.key()) << " " << l.value() << "\n";
+        }
+    }
+
+    for (auto it = _histograms.cbegin(); it != _histograms.cend(); ++it) {
+        ts << "# TYPE " << it.key() << " histogram\n";
+        for (auto h = it->cbegin(); h != it->cend(); ++h) {
+            QString prefix = h.key().isEmpty() ? QString() : h.key() + ",";
+            const auto& bounds = Histogram::bounds();
+            quint64 cumulative = 0;
+            for (int i = 0; i <= bounds.size(); i++) {
+                cumulative += h->counts()[i];
+                QString le = i < bounds.size() ? QString::number(bounds[i]) : QString("+Inf");
+                ts << it.key() << "_bucket{" << prefix << "le=\"" << le << "\"} " << cumulative << "\n";
+            }
+            ts << it.key() << "_sum" << braced(h.key()) << " " << h->sum() << "\n";
+            ts << it.key() << "_count" << braced(h.key()) << " " << h->count() << "\n";
+        }
+    }
+
+    ts.flush();
+    return out;
+}
+
+void Metrics::flush()
+{
+    if (_path.isEmpty()) return;
+
+    QSaveFile f(_path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        wmm_warning() << "can not open" << _path;
+        return;
+    }
+
+    f.write(exposition());
+    f.commit();
+}
+
+}
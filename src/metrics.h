@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QtCore>
+#include "histogram.h"
+
+namespace wmm {
+/**
+ * Process wide counters and latency histograms, written out in the
+ * Prometheus text format to $XDG_RUNTIME_DIR/deepin-wm-switcher/metrics.prom
+ * so that they can be scraped without talking D-Bus.
+ *
+ * Recording is thread safe. The file is rewritten atomically at most
+ * once per FLUSH_DELAY after something changed.
+ */
+class Metrics: public QObject {
+    Q_OBJECT
+    public:
+        static Metrics& instance();
+
+        /**
+         * start exporting. the first call to instance() decides which
+         * thread the flush timer lives in, so call this early from main.
+         */
+        void exportTo(const QString& path = QString());
+
+        void inc(const QString& name, const QString& labels = QString(), quint64 n = 1);
+        void observe(const QString& name, const QString& labels, qint64 ms);
+
+        /**
+         * key="value", escaped as the text format wants
+         */
+        static QString label(const QString& key, const QString& value);
+
+        QByteArray exposition() const;
+
+    private slots:
+        void scheduleFlush();
+        void flush();
+
+    private:
+        const int FLUSH_DELAY = 1000;
+
+        mutable QMutex _lock;
+        // name -> labels -> value
+        QMap<QString, QMap<QString, quint64>> _counters;
+        QMap<QString, QMap<QString, Histogram>> _histograms;
+
+        QString _path;
+        QTimer* _flushTimer {nullptr};
+
+        Metrics();
+        void changed();
+};
+}
@@ -0,0 +1,608 @@
+#include "config.h"
+#include "monitor.h"
+#include "rules.h"
+#include "metrics.h"
+
+#include <QX11Info>
+
+using namespace std;
+
+// errorOccurred() is new in Qt 5.6
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 6, 0))
+#define PROC_ERROR_SIGNAL SIGNAL(errorOccurred(QProcess::ProcessError))
+#else
+#define PROC_ERROR_SIGNAL SIGNAL(error(QProcess::ProcessError))
+#endif
+
+namespace wmm {
+
+static const char* const SPAWN_STATES[] = {
+    "idle",
+    "starting",
+    "running",
+    "backoff",
+    "no_executable",
+};
+
+WindowManagerMonitor::WindowManagerMonitor(const QString& display, QObject* parent)
+    :QObject(parent),
+    _display(display)
+{
+}
+
+void WindowManagerMonitor::start(const WindowManagerList::iterator& init_wm)
+{
+    _voted = init_wm;
+
+    _current = _voted;
+    wmm_info() << QString("exec wm %1 on %2").arg(C2Q(_current->genericName))
+        .arg(_display.isEmpty() ? QString::fromLocal8Bit(qgetenv("DISPLAY")) : _display);
+
+    // the input method panel is one per session, only the primary
+    // display looks after it. the others still time their switches.
+    if (_display.isEmpty()) {
+        _actions.add(new SogouAction());
+    }
+    connect(&_actions, SIGNAL(finished()), this, SLOT(onPostActionsDone()));
+
+    if (_display.isEmpty()) {
+        _selection = new WMSelectionWatcher(QX11Info::appScreen(), this);
+    } else {
+        _selection = new WMSelectionWatcher(_display, this);
+    }
+    connect(_selection, SIGNAL(ownerChanged(quint32)), this, SLOT(onWMOwnerChanged(quint32)));
+    connect(_selection, SIGNAL(supportingWMCheckChanged(quint32)), this, SLOT(checkReady()));
+
+    _readyTimer.setSingleShot(true);
+    _readyTimer.setInterval(READY_TIMEOUT);
+    connect(&_readyTimer, SIGNAL(timeout()), this, SLOT(onWMReady()));
+
+    _ownerLostTimer.setSingleShot(true);
+    _ownerLostTimer.setInterval(KILL_TIMEOUT);
+    connect(&_ownerLostTimer, SIGNAL(timeout()), this, SLOT(onWMOwnerLost()));
+
+    connect(&_locator, SIGNAL(changed()), this, SLOT(onPathChanged()));
+
+    _respawnTimer.setSingleShot(true);
+    connect(&_respawnTimer, SIGNAL(timeout()), this, SLOT(spawn()));
+
+    connect(&_breaker, SIGNAL(retry()), this, SLOT(spawn()));
+    _stableTimer.setSingleShot(true);
+    _stableTimer.setInterval(STABLE_PERIOD);
+    connect(&_stableTimer, SIGNAL(timeout()), this, SLOT(onWMStable()));
+
+    auto hog = global_config.value("cpu_hog").toObject();
+    _hogCheck = hog["enabled"].toBool(true);
+    _hogDetector.setPolicy(CpuHogPolicy::fromJson(hog));
+    connect(&_hogDetector, SIGNAL(hogDetected(qint64, int)), this, SLOT(onWMHogging()));
+
+    auto pacing = global_config.value("frame_pacing").toObject();
+    _pacingCheck = pacing["enabled"].toBool(true);
+    _pacing.setPolicy(FramePacingPolicy::fromJson(pacing));
+    connect(&_pacing, SIGNAL(janky(double)), this, SLOT(onWMJanky()));
+
+    if (_pressure) {
+        connect(_pressure, SIGNAL(raised()), this, SLOT(onPressureRaised()));
+        connect(_pressure, SIGNAL(cleared()), this, SLOT(onPressureCleared()));
+    }
+
+    _cgroup.setup(CGroupPolicy::fromJson(global_config.value("cgroup").toObject()));
+    connect(&_cgroup, SIGNAL(overBudget(const QString&, const QString&)),
+            this, SLOT(onWMOverBudget()));
+
+    _warmStandby = global_config.value("warm_standby").toBool(false);
+
+    connect(&global_config, SIGNAL(changed()), this, SLOT(onConfigChanged()));
+    connect(&global_config, SIGNAL(reloaded()), this, SLOT(onConfigReloaded()));
+
+    spawn();
+}
+
+const QString WindowManagerMonitor::currentWM() const
+{
+    return C2Q(_current->genericName);
+}
+
+WindowManagerMonitor::~WindowManagerMonitor()
+{
+    if (_oldProc) delete _oldProc;
+    if (_proc) delete _proc;
+}
+
+void WindowManagerMonitor::onToggleWM()
+{
+    WMPointer to = toggleTarget();
+    if (!allowSwitch(to)) return;
+
+    if (_breaker.state() == CrashBreaker::Open) {
+        wmm_info() << "switch requested, reset crash breaker";
+        _breaker.reset();
+    }
+
+    switchTo(to);
+}
+
+WMPointer WindowManagerMonitor::toggleTarget() const
+{
+    if (_current == wms.end()) return _current;
+
+    // from any 3d rung to 2d, and from 2d back to the top
+    return _current->is3D && _current != bad_wm ? bad_wm : good_wm;
+}
+
+void WindowManagerMonitor::switchTo(WMPointer to, bool remember)
+{
+    _current = to;
+    _requestedNotify = _current->is3D ? &NotifyHelper::notifyStart3D : &NotifyHelper::notifyStart2D;
+
+    _switchTimer.begin(C2Q(_current->id));
+    Metrics::instance().inc("wmm_switches_total", Metrics::label("to", C2Q(_current->id)));
+
+    // the choice is remembered for the display we run on only
+    if (remember && _display.isEmpty()) {
+        _voted = _current;
+        global_config.selectWM(C2Q(_current->id));
+    }
+
+    spawn();
+}
+
+void WindowManagerMonitor::onConfigChanged()
+{
+    auto old_permission = switch_permission;
+    WMPointer wanted = apply_config();
+    if (switch_permission != old_permission) {
+        wmm_info() << QString("switch permission %1 -> %2").arg(old_permission).arg(switch_permission);
+    }
+
+    // last_wm is the choice for the display we run on only. the others
+    // keep theirs, and an edit of some other key changes nothing.
+    if (!_display.isEmpty() || wanted == wms.end() || wanted == _voted) {
+        return;
+    }
+
+    wmm_info() << QString("config asks for %1").arg(C2Q(wanted->genericName));
+    _voted = wanted;
+
+    // a locked out or missing wm is not brought back by an edit, the
+    // new choice is taken once the breaker is reset or a wm installed
+    if (_state == NoExecutable) {
+        wmm_info() << "no wm installed, spawn it later";
+        return;
+    }
+    if (_breaker.state() == CrashBreaker::Open) {
+        wmm_info() << "crash breaker is open, spawn it once reset";
+        _current = wanted;
+        return;
+    }
+
+    // a policy pushed by the admin is followed even when the user may
+    // not switch by hand
+    if (wanted != _current && _current != wms.end()) {
+        switchTo(wanted, false);
+    }
+}
+
+void WindowManagerMonitor::onConfigReloaded()
+{
+    // the running wm gets them too, no respawn needed
+    _cgroup.setup(CGroupPolicy::fromJson(global_config.value("cgroup").toObject()));
+}
+
+QString WindowManagerMonitor::cgroupKey(WMPointer wm) const
+{
+    QString id = C2Q(wm->id);
+    if (_display.isEmpty()) return id;
+
+    // ":1.0" -> "deepin-wm@1.0"
+    return QString("%1@%2").arg(id).arg(QString(_display).remove(':'));
+}
+
+bool WindowManagerMonitor::allowSwitch(WMPointer to)
+{
+    wmm_debug() << __func__ << "switch_permission = " << switch_permission;
+    if (to == wms.end() || _current == wms.end() || to == _current) {
+        return false;
+    }
+
+    switch (switch_permission) {
+        case ALLOW_NONE: return false;
+        case ALLOW_BOTH: break;
+        case ALLOW_TO_2D: return _current->is3D || !to->is3D;
+        case ALLOW_TO_3D: return !_current->is3D || to->is3D;
+    }
+
+    return true;
+}
+
+void WindowManagerMonitor::doSanityCheck()
+{
+    auto installed = [this](WMPointer wm) {
+        return !_locator.find(C2Q(wm->execName)).isEmpty();
+    };
+
+    if (_current == wms.end() || installed(_current)) return;
+
+    // the nearest rung that is installed, lighter ones first
+    auto old = _current;
+    _current = wms.end();
+    for (auto wm = old + 1; wm != wms.end(); ++wm) {
+        if (installed(wm)) {
+            _current = wm;
+            break;
+        }
+    }
+    for (auto wm = old; _current == wms.end() && wm != wms.begin();) {
+        if (installed(--wm)) {
+            _current = wm;
+        }
+    }
+
+    wmm_warning() << QString("%1: %2 -> %3").arg(__func__)
+        .arg(old->genericName.c_str())
+        .arg(_current != wms.end() ? _current->genericName.c_str() : "");
+    _requestedNotify = nullptr;
+}
+
+void WindowManagerMonitor::setState(SpawnState state)
+{
+    if (_stateClock.isValid()) {
+        Metrics::instance().observe("wmm_spawn_state_ms",
+                Metrics::label("state", SPAWN_STATES[_state]), _stateClock.elapsed());
+    }
+
+    wmm_debug() << QString("spawn state %1 -> %2").arg(SPAWN_STATES[_state]).arg(SPAWN_STATES[state]);
+    _state = state;
+    _stateClock.start();
+}
+
+void WindowManagerMonitor::retire(CGroupProcess* p)
+{
+    if (!p) return;
+
+    p->disconnect(this);
+    if (p->state() == QProcess::NotRunning) {
+        delete p;
+        return;
+    }
+
+    // deleting a running QProcess would block until it is gone
+    wmm_warning() << QString("%1 is running, force it to terminate").arg(p->program());
+    connect(p, SIGNAL(finished(int, QProcess::ExitStatus)), p, SLOT(deleteLater()));
+    connect(p, PROC_ERROR_SIGNAL, p, SLOT(deleteLater()));
+    p->kill();
+}
+
+void WindowManagerMonitor::retireOldProc()
+{
+    if (!_oldProc) return;
+
+    auto* p = _oldProc;
+    _oldProc = nullptr;
+    if (p->state() == QProcess::NotRunning) {
+        retire(p);
+        _switchTimer.mark(SwitchTimer::OldTerminated);
+        return;
+    }
+
+    // timed when it actually left, or lost the selection to the new one
+    retire(p);
+    connect(p, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(onOldProcFinished()));
+}
+
+void WindowManagerMonitor::onOldProcFinished()
+{
+    _switchTimer.mark(SwitchTimer::OldTerminated);
+}
+
+void WindowManagerMonitor::spawn()
+{
+    _respawnTimer.stop();
+    _stableTimer.stop();
+    _hogDetector.stop();
+    _pacing.stop();
+    _procOwnedSelection = false;
+    _ownerLostTimer.stop();
+    _awaitingReady = false;
+    _readyTimer.stop();
+
+    // the old wm is left running until the new one is up, so that
+    // --replace can take over from it
+    retire(_oldProc);
+    _oldProc = _proc;
+    _proc = nullptr;
+    if (_oldProc) _oldProc->disconnect(this);
+
+    doSanityCheck();
+    if (_current == wms.end()) {
+        retireOldProc();
+        waitForExecutable();
+        return;
+    }
+
+    QString exec = C2Q(_current->execName);
+    QString id = C2Q(_current->id);
+    QString key = cgroupKey(_current);
+    _proc = new CGroupProcess;
+    _proc->setCGroupProcsFile(_cgroup.procsFile(key));
+    _cgroup.watch(key);
+
+    auto sys_env = QProcessEnvironment::systemEnvironment();
+    sys_env.insert(_current->env);
+    sys_env.insert("GDK_SCALE", "1");
+    if (!_display.isEmpty()) {
+        sys_env.insert("DISPLAY", _display);
+    }
+
+    connect(_proc, SIGNAL(finished(int, QProcess::ExitStatus)),
+                this, SLOT(onWMProcFinished(int, QProcess::ExitStatus)));
+    connect(_proc, SIGNAL(started()), this, SLOT(onWMProcStarted()));
+    connect(_proc, PROC_ERROR_SIGNAL, this, SLOT(onWMProcError(QProcess::ProcessError)));
+    _proc->setProcessEnvironment(sys_env);
+    _ownerAtSpawn = _selection->owner();
+    _checkAtSpawn = _selection->supportingWMCheck();
+    _awaitingReady = true;
+    _readyTimer.start();
+
+    // the rest happens in onWMProcStarted or onWMProcError, and in
+    // onWMReady once it manages the screen
+    _proc->start(_locator.find(exec), QStringList() << "--replace");
+    setState(Starting);
+
+    emit onWMChanged();
+    Metrics::instance().inc("wmm_spawns_total", Metrics::label("wm", id));
+}
+
+void WindowManagerMonitor::do_post_actions(WMPointer current)
+{
+    if (current == wms.end()) return;
+
+    wmm_info() << __func__ << "on" << (current->is3D ? "3d" : "2d") << "wm";
+    _actions.run(current->is3D);
+}
+
+void WindowManagerMonitor::onPostActionsDone()
+{
+    _switchTimer.mark(SwitchTimer::PostActionsDone);
+}
+
+void WindowManagerMonitor::checkReady()
+{
+    if (!_awaitingReady) return;
+
+    auto owner = _selection->owner();
+    auto check = _selection->supportingWMCheck();
+    if (owner != XCB_NONE && owner != _ownerAtSpawn
+            && check != XCB_NONE && check != _checkAtSpawn) {
+        onWMReady();
+    }
+}
+
+void WindowManagerMonitor::onWMReady()
+{
+    if (!_awaitingReady) return;
+    _awaitingReady = false;
+
+    if (_readyTimer.isActive()) {
+        _readyTimer.stop();
+        wmm_info() << C2Q(_current->genericName) << "is ready";
+    } else {
+        wmm_warning() << QString("%1 is not ready after %2ms, go on")
+            .arg(C2Q(_current->genericName)).arg(READY_TIMEOUT);
+    }
+
+    do_post_actions(_current);
+    showRequestedNotify();
+
+    // frames only tell something once the wm paints the screen
+    if (_pacingCheck && lighter_wm(_current) != _current) {
+        _pacing.watch(_display);
+    }
+}
+
+void WindowManagerMonitor::showRequestedNotify()
+{
+    if (_requestedNotify != nullptr) {
+        (_notify.*_requestedNotify)();
+        _requestedNotify = nullptr;
+    }
+}
+
+void WindowManagerMonitor::onWMProcFinished(int exitCode, QProcess::ExitStatus status)
+{
+    wmm_info() << __func__ << ": exitCode = " << exitCode;
+
+    _stableTimer.stop();
+    _hogDetector.stop();
+    _pacing.stop();
+    _awaitingReady = false;
+    _readyTimer.stop();
+
+    if (status == QProcess::CrashExit || exitCode != 0) {
+        wmm_warning() << QString("%1 crashed or failure, switch wm").arg(_proc->program());
+        if (!recoverFromCrash()) return;
+    }
+
+    scheduleRespawn();
+}
+
+void WindowManagerMonitor::onWMProcStarted()
+{
+    setState(Running);
+    _switchTimer.mark(SwitchTimer::NewStarted);
+    retireOldProc();
+
+    _stableTimer.start();
+
+    // only a busy wm with a lighter rung below can be helped
+    if (_hogCheck && lighter_wm(_current) != _current) {
+        _hogDetector.watch(_proc->processId(), _cgroup.cpuStatFile(cgroupKey(_current)));
+    }
+}
+
+void WindowManagerMonitor::onWMProcError(QProcess::ProcessError error)
+{
+    // crashes are handled once finished() comes
+    if (error != QProcess::FailedToStart) return;
+
+    wmm_warning() << QString("%1 start failed: %2").arg(_proc->program()).arg(_proc->errorString());
+    _awaitingReady = false;
+    _readyTimer.stop();
+    _locator.invalidate();
+    retireOldProc();
+
+    if (recoverFromCrash()) {
+        scheduleRespawn();
+    }
+}
+
+bool WindowManagerMonitor::recoverFromCrash()
+{
+    _requestedNotify = &NotifyHelper::notify3DError;
+    _breaker.recordCrash(C2Q(_current->id));
+    Metrics::instance().inc("wmm_crashes_total", Metrics::label("wm", C2Q(_current->id)));
+
+    // one rung down, or up when the lightest one crashed
+    auto next = lighter_wm(_current);
+    if (next == _current) {
+        next = heavier_wm(_current);
+    }
+    if (allowSwitch(next)) {
+        _current = next;
+    }
+
+    if (_breaker.shouldTrip(C2Q(_current->id))) {
+        _breaker.trip();
+        setState(Idle);
+        _requestedNotify = nullptr;
+        _notify.notify3DError();
+        return false;
+    }
+
+    // recovering from a crash is a switch as well
+    _switchTimer.begin(C2Q(_current->id));
+    _switchTimer.mark(SwitchTimer::OldTerminated);
+    return true;
+}
+
+void WindowManagerMonitor::scheduleRespawn()
+{
+    setState(Backoff);
+    _respawnTimer.start(_breaker.backoff(C2Q(_current->id)));
+}
+
+void WindowManagerMonitor::onWMHogging()
+{
+    auto next = lighter_wm(_current);
+    if (!allowSwitch(next)) return;
+
+    wmm_warning() << QString("%1 keeps cpu busy, fallback to %2")
+        .arg(C2Q(_current->genericName)).arg(C2Q(next->genericName));
+    switchTo(next);
+}
+
+void WindowManagerMonitor::onWMJanky()
+{
+    auto next = lighter_wm(_current);
+    if (!allowSwitch(next)) return;
+
+    wmm_warning() << QString("%1 stutters, fallback to %2")
+        .arg(C2Q(_current->genericName)).arg(C2Q(next->genericName));
+    switchTo(next);
+}
+
+void WindowManagerMonitor::onPressureRaised()
+{
+    if (_current == wms.end() || !_current->is3D) return;
+
+    auto to = toggleTarget();
+    if (!allowSwitch(to)) return;
+
+    wmm_warning() << QString("under pressure, switch to %1 for now").arg(C2Q(to->genericName));
+    _beforePressure = _current;
+    _pressureTarget = to;
+    switchTo(to, false);
+}
+
+void WindowManagerMonitor::onPressureCleared()
+{
+    auto back = _beforePressure;
+    _beforePressure = wms.end();
+    if (back == wms.end() || _current != _pressureTarget || !allowSwitch(back)) return;
+
+    wmm_info() << QString("pressure is over, back to %1").arg(C2Q(back->genericName));
+    switchTo(back, false);
+}
+
+void WindowManagerMonitor::onWMOverBudget()
+{
+    if (!_proc || _proc->state() != QProcess::Running) return;
+
+    auto next = lighter_wm(_current);
+    if (allowSwitch(next)) {
+        switchTo(next);
+    } else {
+        wmm_warning() << QString("restart %1").arg(_proc->program());
+        _proc->kill();
+    }
+}
+
+void WindowManagerMonitor::onWMStable()
+{
+    if (_current != wms.end()) {
+        _breaker.recordStable(C2Q(_current->id));
+    }
+
+    // keep the other wm hot for a quick toggle
+    auto other = toggleTarget();
+    if (_warmStandby && allowSwitch(other)) {
+        _prefetcher.prefetch(C2Q(other->execName));
+    }
+}
+
+void WindowManagerMonitor::waitForExecutable()
+{
+    wmm_warning() << "there is no wm running currently, wait for one to be installed";
+    // PATH dirs may have come or gone since the last look, and a change
+    // which brought no wm must not leave us deaf to the next one
+    _locator.rearm();
+    setState(NoExecutable);
+}
+
+void WindowManagerMonitor::onPathChanged()
+{
+    if (_state != NoExecutable) return;
+
+    wmm_info() << "PATH changed, try launch wm";
+    _current = _voted;
+    spawn();
+}
+
+void WindowManagerMonitor::onWMOwnerChanged(quint32 owner)
+{
+    if (owner != XCB_NONE) {
+        _ownerLostTimer.stop();
+        // --replace took WM_S from the old wm, it is done managing even
+        // if its process has not exited yet
+        _switchTimer.mark(SwitchTimer::OldTerminated);
+        _switchTimer.mark(SwitchTimer::SelectionOwned);
+        _procOwnedSelection = _proc && _proc->state() == QProcess::Running;
+        checkReady();
+    } else if (_procOwnedSelection && _proc->state() == QProcess::Running) {
+        // a replacing wm takes over shortly, give it some time
+        _ownerLostTimer.start();
+    }
+}
+
+void WindowManagerMonitor::onWMOwnerLost()
+{
+    if (_selection->owner() != XCB_NONE) return;
+    if (!_proc || _proc->state() != QProcess::Running) return;
+
+    // still running but not managing the screen anymore,
+    // let the crash path pick a working wm.
+    wmm_warning() << QString("%1 dropped wm selection, kill it").arg(_proc->program());
+    _proc->kill();
+}
+
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <QtCore>
+
+#include "window_manager.h"
+#include "notify_helper.h"
+#include "actions.h"
+#include "wm_selection.h"
+#include "crash_breaker.h"
+#include "cpu_hog.h"
+#include "frame_pacing.h"
+#include "pressure.h"
+#include "cgroup.h"
+#include "prefetch.h"
+#include "switch_timer.h"
+#include "exec_locator.h"
+
+namespace wmm {
+/**
+ * keeps one wm of the ladder running on a display. the user toggles
+ * between 3d and 2d, while crashes and overload step one rung at a
+ * time. hardware is probed once for all displays, the rest is per
+ * monitor.
+ */
+class WindowManagerMonitor: public QObject {
+    Q_OBJECT
+    public:
+        /**
+         * display is like ":1" or ":1.0", empty for the one we run on
+         */
+        explicit WindowManagerMonitor(const QString& display = QString(), QObject* parent = nullptr);
+
+        void start(const WindowManagerList::iterator& init_wm);
+
+        const QString currentWM() const;
+        const QString& display() const { return _display; }
+
+        /**
+         * shared by the monitors of all displays, not owned. set it
+         * before start(), pressure is not watched without one.
+         */
+        void setPressureWatcher(PressureWatcher* pressure) { _pressure = pressure; }
+
+        CrashBreaker& breaker() { return _breaker; }
+        const SwitchTimer& switchTimer() const { return _switchTimer; }
+
+        virtual ~WindowManagerMonitor();
+
+    signals:
+        void onWMChanged();
+
+    public slots:
+        void onToggleWM();
+        /**
+         * follow config files changed behind our back
+         */
+        void onConfigChanged();
+
+    private:
+        enum SpawnState {
+            Idle,
+            Starting,
+            Running,
+            Backoff,
+            NoExecutable,
+        };
+
+        QString _display;
+        WMPointer _current { wms.end() };
+        WMPointer _voted { wms.end() };
+        CGroupProcess* _proc {nullptr};
+        // replaced by _proc, killed once that one is up
+        CGroupProcess* _oldProc {nullptr};
+
+        SpawnState _state {Idle};
+        QElapsedTimer _stateClock;
+        QTimer _respawnTimer;
+        ActionPipeline _actions;
+        NotifyHelper _notify;
+
+        using NotifyRequest = void (NotifyHelper::*)();
+        NotifyRequest _requestedNotify {nullptr};
+
+        WMSelectionWatcher* _selection {nullptr};
+        QTimer _ownerLostTimer;
+        // only a wm that once managed the screen can be said to lose it
+        bool _procOwnedSelection {false};
+        // selection state when the current wm was spawned, it is ready
+        // once it replaced both
+        bool _awaitingReady {false};
+        quint32 _ownerAtSpawn {XCB_NONE};
+        quint32 _checkAtSpawn {XCB_NONE};
+        QTimer _readyTimer;
+        ExecutableLocator _locator;
+
+        const int RESPAWN_DELAY = 500;
+        // longest wait for a new wm to show up as ready
+        const int READY_TIMEOUT = 5000;
+        const int KILL_TIMEOUT = 3000;
+        const int STABLE_PERIOD = 10000;
+
+        CrashBreaker _breaker {RESPAWN_DELAY};
+        QTimer _stableTimer;
+
+        bool _hogCheck {true};
+        CpuHogDetector _hogDetector;
+        bool _pacingCheck {true};
+        FramePacingMonitor _pacing;
+
+        PressureWatcher* _pressure {nullptr};
+        // where we left for pressure and went to, to come back once it
+        // is over unless someone switched in between
+        WMPointer _beforePressure { wms.end() };
+        WMPointer _pressureTarget { wms.end() };
+        WMCGroup _cgroup;
+
+        bool _warmStandby {false};
+        Prefetcher _prefetcher;
+
+        SwitchTimer _switchTimer;
+
+        /**
+         * whether switch_permission allows to go from _current to wm
+         */
+        bool allowSwitch(WMPointer to);
+        /**
+         * where a toggle by the user goes
+         */
+        WMPointer toggleTarget() const;
+        /**
+         * remember: store it as the user's choice
+         */
+        void switchTo(WMPointer to, bool remember = true);
+        /**
+         * cgroup leaf of wm, kept apart per display
+         */
+        QString cgroupKey(WMPointer wm) const;
+        void doSanityCheck();
+        /**
+         * time spent in the state left goes to wmm_spawn_state_ms
+         */
+        void setState(SpawnState state);
+        /**
+         * kill p without waiting for it, it deletes itself when reaped
+         */
+        void retire(CGroupProcess* p);
+        void retireOldProc();
+        /**
+         * book a crash or failed start of the current wm and pick the
+         * next one. false if the crash breaker tripped.
+         */
+        bool recoverFromCrash();
+        void scheduleRespawn();
+
+    private slots:
+        void spawn();
+        /**
+         * returns at once, actions run on a worker thread
+         */
+        void do_post_actions(WMPointer current);
+        void onPostActionsDone();
+        void showRequestedNotify();
+        void checkReady();
+        /**
+         * the new wm manages the screen, or READY_TIMEOUT passed
+         */
+        void onWMReady();
+        void onWMProcFinished(int exitCode, QProcess::ExitStatus status);
+        void onWMProcStarted();
+        void onWMProcError(QProcess::ProcessError error);
+        /**
+         * the wm switched away from is gone
+         */
+        void onOldProcFinished();
+        void onWMHogging();
+        /**
+         * frames of the wm stutter for long, step down a rung
+         */
+        void onWMJanky();
+        /**
+         * the system is under memory or cpu pressure for long, make
+         * room by toggling to 2d until it is over
+         */
+        void onPressureRaised();
+        void onPressureCleared();
+        /**
+         * the wm is throttled by its cgroup already. step down a rung
+         * if we can, otherwise replace it with a fresh instance.
+         */
+        void onWMOverBudget();
+        /**
+         * limits in the config may have changed
+         */
+        void onConfigReloaded();
+        void onWMStable();
+        /**
+         * no wm could be found in PATH, wait until something gets
+         * installed instead of polling for it.
+         */
+        void waitForExecutable();
+        void onPathChanged();
+        void onWMOwnerChanged(quint32 owner);
+        void onWMOwnerLost();
+};
+}
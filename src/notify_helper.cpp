@@ -0,0 +1,87 @@
+#include "config.h"
+#include "notify_helper.h"
+#include "metrics.h"
+
+namespace wmm {
+
+static const char* const OSD_SERVICE = "com.deepin.dde.osd";
+
+NotifyHelper::NotifyHelper(QObject* parent)
+    :QObject(parent),
+    _watcher(OSD_SERVICE, QDBusConnection::sessionBus(), QDBusServiceWatcher::WatchForOwnerChange)
+{
+    _coalesceTimer.setSingleShot(true);
+    _coalesceTimer.setInterval(COALESCE_DELAY);
+    connect(&_coalesceTimer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    connect(&_watcher, SIGNAL(serviceOwnerChanged(const QString&, const QString&, const QString&)),
+            this, SLOT(onOwnerChanged(const QString&, const QString&, const QString&)));
+}
+
+void NotifyHelper::osd(QString name)
+{
+    Metrics::instance().inc("wmm_notifications_total", Metrics::label("name", name));
+
+    // only the latest of a burst is shown
+    _queued = name;
+    if (!_coalesceTimer.isActive()) {
+        _coalesceTimer.start();
+    }
+}
+
+void NotifyHelper::flush()
+{
+    if (_inflight || _queued.isEmpty()) return;
+
+    if (_queued == _lastShown && _lastShownAt.isValid()
+            && !_lastShownAt.hasExpired(REPEAT_INTERVAL)) {
+        wmm_info() << "osd" << _queued << "shown just now, drop it";
+        _queued.clear();
+        return;
+    }
+
+    auto msg = QDBusMessage::createMethodCall(OSD_SERVICE, "/", OSD_SERVICE, "ShowOSD");
+    msg << _queued;
+    auto call = QDBusConnection::sessionBus().asyncCall(msg, CALL_TIMEOUT);
+
+    _inflight = new QDBusPendingCallWatcher(call, this);
+    _inflight->setProperty("name", _queued);
+    connect(_inflight, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onReply(QDBusPendingCallWatcher*)));
+
+    _lastShown = _queued;
+    _lastShownAt.start();
+    _queued.clear();
+}
+
+void NotifyHelper::onReply(QDBusPendingCallWatcher* call)
+{
+    call->deleteLater();
+    _inflight = nullptr;
+
+    if (call->isError()) {
+        auto error = call->error();
+        wmm_warning() << "ShowOSD failed:" << error.message();
+        // not on the bus yet, show it once it is, unless a newer one
+        // is waiting already
+        if (error.type() == QDBusError::ServiceUnknown) {
+            if (_queued.isEmpty()) {
+                _queued = call->property("name").toString();
+                _lastShownAt.invalidate();
+            }
+            return;
+        }
+    }
+
+    flush();
+}
+
+void NotifyHelper::onOwnerChanged(const QString&, const QString&, const QString& newOwner)
+{
+    if (!newOwner.isEmpty()) {
+        wmm_info() << OSD_SERVICE << "appears on the bus";
+        flush();
+    }
+}
+
+}
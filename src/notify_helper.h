@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QtCore>
+#include <QtDBus>
+
+namespace wmm {
+/**
+ * Shows switching osd of dde. Calls are made without introspection and
+ * never waited on. A burst of requests ends up as a single call for the
+ * latest one, and at most one call is in flight; the same osd is not
+ * shown twice within REPEAT_INTERVAL. Requests made while dde-osd is
+ * not there yet are delivered once it shows up on the bus.
+ */
+class NotifyHelper: public QObject {
+    Q_OBJECT
+    public:
+        explicit NotifyHelper(QObject* parent = nullptr);
+
+        void notifyStart3D() { osd("SwitchWM3D"); }
+
+        void notifyStart2D() { osd("SwitchWM2D"); }
+
+        void notify3DError() { osd("SwitchWMError"); }
+
+    private slots:
+        void flush();
+        void onReply(QDBusPendingCallWatcher* call);
+        void onOwnerChanged(const QString& service, const QString& oldOwner, const QString& newOwner);
+
+    private:
+        const int COALESCE_DELAY = 200;
+        const int REPEAT_INTERVAL = 2000;
+        const int CALL_TIMEOUT = 5000;
+
+        QDBusServiceWatcher _watcher;
+        QTimer _coalesceTimer;
+        QString _queued;
+        QDBusPendingCallWatcher* _inflight {nullptr};
+
+        QString _lastShown;
+        QElapsedTimer _lastShownAt;
+
+        void osd(QString name);
+};
+}
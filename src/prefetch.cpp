@@ -0,0 +1,93 @@
+#include "config.h"
+#include "prefetch.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace wmm {
+
+class ReadaheadTask: public QRunnable {
+    public:
+        explicit ReadaheadTask(const QStringList& files): _files(files) {}
+
+        void run() override {
+            for (const auto& file: _files) {
+                int fd = open(QFile::encodeName(file).constData(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) continue;
+                // kicks off async readahead of the whole file
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                close(fd);
+            }
+        }
+
+    private:
+        QStringList _files;
+};
+
+Prefetcher::Prefetcher(QObject* parent)
+    :QObject(parent)
+{
+}
+
+void Prefetcher::prefetch(const QString& execName)
+{
+    if (_closures.contains(execName)) {
+        readahead(_closures[execName]);
+        return;
+    }
+
+    // one ldd at a time is plenty, the other wm will come again
+    if (_ldd) return;
+
+    QString path = QStandardPaths::findExecutable(execName);
+    if (path.isEmpty()) return;
+
+    _pending = execName;
+    _ldd = new QProcess(this);
+    _ldd->setProperty("binary", path);
+    connect(_ldd, SIGNAL(finished(int, QProcess::ExitStatus)),
+            this, SLOT(onLddFinished(int, QProcess::ExitStatus)));
+    _ldd->start("ldd", QStringList() << path);
+}
+
+void Prefetcher::onLddFinished(int exitCode, QProcess::ExitStatus status)
+{
+    QStringList files;
+    files << _ldd->property("binary").toString();
+    if (status == QProcess::NormalExit && exitCode == 0) {
+        files << parseLdd(_ldd->readAllStandardOutput());
+    }
+
+    _ldd->deleteLater();
+    _ldd = nullptr;
+
+    wmm_info() << "prefetch" << _pending << "with" << files.size() - 1 << "libraries";
+    _closures[_pending] = files;
+    readahead(files);
+}
+
+QStringList Prefetcher::parseLdd(const QByteArray& output)
+{
+    // libfoo.so.1 => /usr/lib/libfoo.so.1 (0x...)
+    // /lib64/ld-linux-x86-64.so.2 (0x...)
+    QStringList files;
+    for (auto ln: output.split('\n')) {
+        ln = ln.trimmed();
+        int arrow = ln.indexOf("=> ");
+        auto path = arrow >= 0 ? ln.mid(arrow + 3) : ln;
+        int paren = path.indexOf(" (");
+        if (paren > 0) path = path.left(paren);
+
+        if (path.startsWith('/')) {
+            files << QFile::decodeName(path);
+        }
+    }
+    return files;
+}
+
+void Prefetcher::readahead(const QStringList& files)
+{
+    QThreadPool::globalInstance()->start(new ReadaheadTask(files));
+}
+
+}
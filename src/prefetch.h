@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * Pulls a wm binary and its shared libraries into the page cache ahead
+ * of time, so switching to it does not wait for disk.
+ *
+ * The library closure is taken from ldd once per binary and remembered;
+ * the actual readahead runs on the global thread pool.
+ */
+class Prefetcher: public QObject {
+    Q_OBJECT
+    public:
+        explicit Prefetcher(QObject* parent = nullptr);
+
+        void prefetch(const QString& execName);
+
+    private slots:
+        void onLddFinished(int exitCode, QProcess::ExitStatus status);
+
+    private:
+        // exec name -> binary and libraries
+        QHash<QString, QStringList> _closures;
+        QProcess* _ldd {nullptr};
+        QString _pending;
+
+        static QStringList parseLdd(const QByteArray& output);
+        static void readahead(const QStringList& files);
+};
+}
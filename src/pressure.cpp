@@ -0,0 +1,158 @@
+#include "config.h"
+#include "pressure.h"
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+namespace wmm {
+
+PressurePolicy PressurePolicy::fromJson(const QJsonObject& obj)
+{
+    PressurePolicy p;
+    p.memoryStall = qMax(obj["memory_stall"].toInt(p.memoryStall), 0);
+    p.cpuStall = qMax(obj["cpu_stall"].toInt(p.cpuStall), 0);
+    // unprivileged triggers fail with EINVAL unless the window is a
+    // multiple of 2s, the kernel takes 10s at most
+    int window = obj["window"].toInt(p.window);
+    p.window = qBound(1, (window + 1000) / 2000, 5) * 2000;
+    if (p.window != window) {
+        wmm_info() << "pressure window" << window << "ms rounded to" << p.window << "ms";
+    }
+    p.memoryStall = qMin(p.memoryStall, p.window);
+    p.cpuStall = qMin(p.cpuStall, p.window);
+    p.sustain = qMax(obj["sustain"].toInt(p.sustain), 0);
+    p.recover = qMax(obj["recover"].toInt(p.recover), 1);
+    return p;
+}
+
+PsiTriggerSource::PsiTriggerSource(QObject* parent)
+    :PressureSource(parent)
+{
+}
+
+PsiTriggerSource::~PsiTriggerSource()
+{
+    stop();
+}
+
+bool PsiTriggerSource::addTrigger(const QString& resource, int stall, int window)
+{
+    if (stall <= 0) return false;
+
+    // the trigger lives as long as the fd
+    QByteArray path = QFile::encodeName("/proc/pressure/" + resource);
+    int fd = open(path.constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        wmm_info() << "no pressure info of" << resource << ":" << strerror(errno);
+        return false;
+    }
+
+    QByteArray trigger = QString("some %1 %2").arg(stall * 1000).arg(window * 1000).toLatin1();
+    if (write(fd, trigger.constData(), trigger.size() + 1) < 0) {
+        wmm_warning() << "can not set pressure trigger" << trigger << "on" << resource << ":" << strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    // Exception notifiers wait for POLLPRI
+    auto* notifier = new QSocketNotifier(fd, QSocketNotifier::Exception, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(onActivated(int)));
+    _notifiers.append(notifier);
+    _resources.insert(fd, resource);
+    return true;
+}
+
+bool PsiTriggerSource::start(const PressurePolicy& policy)
+{
+    stop();
+
+    bool memory = addTrigger("memory", policy.memoryStall, policy.window);
+    bool cpu = addTrigger("cpu", policy.cpuStall, policy.window);
+    return memory || cpu;
+}
+
+void PsiTriggerSource::stop()
+{
+    for (auto* notifier: _notifiers) {
+        int fd = notifier->socket();
+        delete notifier;
+        close(fd);
+    }
+    _notifiers.clear();
+    _resources.clear();
+}
+
+void PsiTriggerSource::onActivated(int fd)
+{
+    emit stalled(_resources.value(fd));
+}
+
+PressureWatcher::PressureWatcher(QObject* parent)
+    :QObject(parent)
+{
+    _quietTimer.setSingleShot(true);
+    connect(&_quietTimer, SIGNAL(timeout()), this, SLOT(onQuiet()));
+    setSource(new PsiTriggerSource);
+}
+
+void PressureWatcher::setSource(PressureSource* source)
+{
+    if (_source) {
+        _source->stop();
+        delete _source;
+    }
+
+    _source = source;
+    _source->setParent(this);
+    connect(_source, SIGNAL(stalled(const QString&)), this, SLOT(onStalled(const QString&)));
+}
+
+bool PressureWatcher::start(const PressurePolicy& policy)
+{
+    _policy = policy;
+    _clock.start();
+    _stallSince = -1;
+    _raised = false;
+    return _source->start(_policy);
+}
+
+void PressureWatcher::stop()
+{
+    _source->stop();
+    _quietTimer.stop();
+    _stallSince = -1;
+    _raised = false;
+}
+
+void PressureWatcher::onStalled(const QString& resource)
+{
+    Metrics::instance().inc("wmm_pressure_stalls_total", Metrics::label("resource", resource));
+
+    qint64 now = _clock.elapsed();
+    if (_stallSince < 0) _stallSince = now;
+
+    if (!_raised && now - _stallSince >= _policy.sustain * 1000LL) {
+        wmm_warning() << QString("%1 pressure for %2s").arg(resource).arg((now - _stallSince) / 1000);
+        _raised = true;
+        emit raised();
+    }
+
+    // a trigger fires at most once per window, missing two ends a
+    // streak. once raised it takes recover to be over.
+    _quietTimer.start(_raised ? _policy.recover * 1000 : _policy.window * 2 + 500);
+}
+
+void PressureWatcher::onQuiet()
+{
+    _stallSince = -1;
+    if (_raised) {
+        wmm_info() << "pressure is low again";
+        _raised = false;
+        emit cleared();
+    }
+}
+
+}
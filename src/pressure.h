@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+struct PressurePolicy {
+    // stall in ms per window that trips a trigger, 0 to not watch
+    int memoryStall {200};
+    int cpuStall {1000};
+    // ms, rounded to a multiple of 2s as unprivileged triggers need
+    int window {2000};
+    // seconds stalls have to keep coming before we act
+    int sustain {10};
+    // seconds without a stall before it is over
+    int recover {60};
+
+    static PressurePolicy fromJson(const QJsonObject& obj);
+};
+
+/**
+ * tells when a resource stalled beyond policy, replaceable by a fake
+ */
+class PressureSource: public QObject {
+    Q_OBJECT
+    public:
+        explicit PressureSource(QObject* parent = nullptr): QObject(parent) {}
+
+        virtual bool start(const PressurePolicy& policy) = 0;
+        virtual void stop() = 0;
+
+    signals:
+        /**
+         * at most once per policy.window for each resource
+         */
+        void stalled(const QString& resource);
+};
+
+/**
+ * PSI triggers on /proc/pressure/{memory,cpu}. The kernel wakes us up
+ * with POLLPRI when "some" stall time in a window goes over the
+ * threshold, nothing is read while pressure is low.
+ */
+class PsiTriggerSource: public PressureSource {
+    Q_OBJECT
+    public:
+        explicit PsiTriggerSource(QObject* parent = nullptr);
+        ~PsiTriggerSource();
+
+        bool start(const PressurePolicy& policy) override;
+        void stop() override;
+
+    private slots:
+        void onActivated(int fd);
+
+    private:
+        QHash<int, QString> _resources;
+        QList<QSocketNotifier*> _notifiers;
+
+        bool addTrigger(const QString& resource, int stall, int window);
+};
+
+/**
+ * raised() once stalls keep coming for policy.sustain, cleared() once
+ * none came for policy.recover after that.
+ */
+class PressureWatcher: public QObject {
+    Q_OBJECT
+    public:
+        explicit PressureWatcher(QObject* parent = nullptr);
+
+        /**
+         * takes ownership, replaces the psi source made by default
+         */
+        void setSource(PressureSource* source);
+        bool start(const PressurePolicy& policy);
+        void stop();
+
+        bool isRaised() const { return _raised; }
+
+    signals:
+        void raised();
+        void cleared();
+
+    private slots:
+        void onStalled(const QString& resource);
+        void onQuiet();
+
+    private:
+        PressurePolicy _policy;
+        PressureSource* _source {nullptr};
+        QTimer _quietTimer;
+        QElapsedTimer _clock;
+        qint64 _stallSince {-1};
+        bool _raised {false};
+};
+}
@@ -0,0 +1,125 @@
+#include "config.h"
+#include "probe_cache.h"
+#include "rule_set.h"
+
+namespace wmm {
+
+ProbeCache::ProbeCache()
+{
+    QString cache_base = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (cache_base.isEmpty()) {
+        cache_base = QString("%1/.cache").arg(QDir::homePath());
+    }
+
+    _path = QString("%1/deepin/deepin-wm-switcher/probe.json").arg(cache_base);
+}
+
+QJsonObject ProbeCache::fingerprint(const HardwareFacts& facts, const QString& rules)
+{
+    QJsonArray cards;
+    for (const auto& dev: facts.cards) {
+        cards.append(QString("%1:%2").arg(dev.vendor_id).arg(dev.dev_id));
+    }
+
+    QJsonObject fp;
+    fp["cards"] = cards;
+    fp["drm_drivers"] = QJsonArray::fromStringList(facts.drmDrivers);
+    fp["kernel"] = facts.kernel;
+    // the log itself is rewritten on every start and may be huge, what
+    // decides its content is keyed on instead
+    fp["xorg"] = facts.xorgBinary;
+    // a new quirk must not be hidden behind a stale result
+    fp["rules"] = rules;
+    return fp;
+}
+
+bool ProbeCache::load()
+{
+    QFile f(_path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QJsonParseError error;
+    auto doc = QJsonDocument::fromJson(f.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        wmm_warning() << "probe cache corrupted:" << error.errorString();
+        return false;
+    }
+
+    auto root = doc.object();
+    if (root["version"].toInt() != VERSION) {
+        wmm_info() << "probe cache version mismatch, ignore";
+        return false;
+    }
+
+    _fingerprint = root["fingerprint"].toObject();
+    _result.decision = root["decision"].toString();
+    _result.permission = root["permission"].toInt();
+    _result.rules.clear();
+    for (const auto& v: root["rules"].toArray()) {
+        auto o = v.toObject();
+        RuleResult r;
+        r.rule = o["rule"].toString();
+        r.wm = o["wm"].toString();
+        auto env = o["env"].toObject();
+        for (auto it = env.constBegin(); it != env.constEnd(); ++it) {
+            r.env.insert(it.key(), it.value().toString());
+        }
+        _result.rules.append(r);
+    }
+
+    return !_result.decision.isEmpty();
+}
+
+bool ProbeCache::isValidFor(const QJsonObject& fingerprint) const
+{
+    return !_fingerprint.isEmpty() && _fingerprint == fingerprint;
+}
+
+bool ProbeCache::save(const QJsonObject& fingerprint, const ProbeResult& result)
+{
+    QFileInfo fi(_path);
+    if (!fi.dir().exists() && !QDir().mkpath(fi.path())) {
+        wmm_warning() << "can not create " << fi.path();
+        return false;
+    }
+
+    QJsonArray rules;
+    for (const auto& r: result.rules) {
+        QJsonObject env;
+        for (const auto& key: r.env.keys()) {
+            env[key] = r.env.value(key);
+        }
+
+        QJsonObject o;
+        o["rule"] = r.rule;
+        o["wm"] = r.wm;
+        o["env"] = env;
+        rules.append(o);
+    }
+
+    QJsonObject root;
+    root["version"] = VERSION;
+    root["fingerprint"] = fingerprint;
+    root["decision"] = result.decision;
+    root["permission"] = result.permission;
+    root["rules"] = rules;
+
+    QSaveFile f(_path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        wmm_warning() << "can not open probe cache to save";
+        return false;
+    }
+    f.write(QJsonDocument(root).toJson());
+    if (!f.commit()) {
+        wmm_warning() << "save probe cache failed";
+        return false;
+    }
+
+    _fingerprint = fingerprint;
+    _result = result;
+    return true;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+struct HardwareFacts;
+
+struct RuleResult {
+    QString rule;
+    // exec name of the wm which the env applies to
+    QString wm;
+    QProcessEnvironment env;
+};
+
+struct ProbeResult {
+    QString decision;
+    int permission {0};
+    QList<RuleResult> rules;
+};
+
+/**
+ * On-disk cache of the hardware rules' outcome. It is only trusted when
+ * the fingerprint of the machine is the same as when it was written, so
+ * that a warm start needs nothing but a few sysfs reads and stats.
+ */
+class ProbeCache {
+    public:
+        ProbeCache();
+
+        /**
+         * pci ids of video cards, drm drivers, kernel release, the X
+         * server binary, its config and dri drivers, and the identity of
+         * the rule files. none of it changes from one boot
+         * to the next unless the machine did.
+         */
+        static QJsonObject fingerprint(const HardwareFacts& facts, const QString& rules);
+
+        /**
+         * read cache from disk, false if missing or of another version
+         */
+        bool load();
+        bool isValidFor(const QJsonObject& fingerprint) const;
+        const ProbeResult& result() const { return _result; }
+
+        bool save(const QJsonObject& fingerprint, const ProbeResult& result);
+
+    private:
+        // bump when the layout or the rules that produce it change
+        static const int VERSION = 4;
+
+        QString _path;
+        QJsonObject _fingerprint;
+        ProbeResult _result;
+};
+}
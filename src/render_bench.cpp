@@ -0,0 +1,238 @@
+#include "config.h"
+#include "render_bench.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+namespace wmm {
+
+static const char* const VERTEX_SHADER =
+    "attribute vec2 pos;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    uv = pos * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(pos, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* const FILL_SHADER =
+    "precision mediump float;\n"
+    "uniform vec4 color;\n"
+    "void main() {\n"
+    "    gl_FragColor = color;\n"
+    "}\n";
+
+static const char* const COMPOSE_SHADER =
+    "precision mediump float;\n"
+    "uniform sampler2D tex;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    gl_FragColor = texture2D(tex, uv);\n"
+    "}\n";
+
+static GLuint compile(GLenum type, const char* src)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static GLuint link(const char* fragment)
+{
+    GLuint vs = compile(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fs = compile(GL_FRAGMENT_SHADER, fragment);
+    if (!vs || !fs) return 0;
+
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glBindAttribLocation(prog, 0, "pos");
+    glLinkProgram(prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(prog);
+        return 0;
+    }
+    return prog;
+}
+
+static GLuint makeTexture(int w, int h)
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    return tex;
+}
+
+/**
+ * draw() in batches until budget ms passed, returns the number of
+ * batches per second
+ */
+template <typename F>
+static double measure(int budget, F draw)
+{
+    // the first batch pays for shader compiles and allocations
+    draw();
+    glFinish();
+
+    QElapsedTimer t;
+    t.start();
+    int batches = 0;
+    do {
+        draw();
+        glFinish();
+        batches++;
+    } while (t.elapsed() < budget);
+
+    return batches * 1000.0 / qMax<qint64>(t.elapsed(), 1);
+}
+
+static bool hasExtension(const char* exts, const char* name)
+{
+    return exts && QByteArray(exts).split(' ').contains(name);
+}
+
+RenderBench::Result RenderBench::run(const QSize& size, int duration)
+{
+    Result result;
+
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    bool surfaceless = false;
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay
+            && hasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+        dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        surfaceless = dpy != EGL_NO_DISPLAY;
+    }
+    if (dpy == EGL_NO_DISPLAY) {
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor)) {
+        wmm_warning() << "render bench: no egl display";
+        return result;
+    }
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    // everything is drawn into a fbo, a pbuffer is only there for
+    // drivers which can not make a context current without a surface
+    bool noSurface = surfaceless
+        || hasExtension(eglQueryString(dpy, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, noSurface ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+    EGLConfig config;
+    EGLint n = 0;
+    EGLContext ctx = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (eglChooseConfig(dpy, configAttribs, &config, 1, &n) && n == 1) {
+        ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, contextAttribs);
+    }
+    if (ctx != EGL_NO_CONTEXT && !noSurface) {
+        surface = eglCreatePbufferSurface(dpy, config, pbufferAttribs);
+    }
+
+    if (ctx == EGL_NO_CONTEXT || (!noSurface && surface == EGL_NO_SURFACE)
+            || !eglMakeCurrent(dpy, surface, surface, ctx)) {
+        wmm_warning() << "render bench: can not make a gles2 context current";
+        if (ctx != EGL_NO_CONTEXT) eglDestroyContext(dpy, ctx);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(dpy, surface);
+        eglTerminate(dpy);
+        return result;
+    }
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+    int w = qBound(1, size.width(), int(maxSize));
+    int h = qBound(1, size.height(), int(maxSize));
+    double mpix = double(w) * h / 1e6;
+
+    GLuint target = makeTexture(w, h);
+    GLuint fbo;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+    GLuint window = makeTexture(w, h);
+    GLuint fill = link(FILL_SHADER);
+    GLuint compose = link(COMPOSE_SHADER);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE && fill && compose) {
+        const GLfloat quad[] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+        glViewport(0, 0, w, h);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, quad);
+        glEnableVertexAttribArray(0);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+        glUseProgram(fill);
+        glUniform4f(glGetUniformLocation(fill, "color"), 0.2f, 0.3f, 0.4f, 0.5f);
+        double quads = measure(duration / 2, [] {
+            for (int i = 0; i < LAYERS; i++) {
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+        }) * LAYERS;
+
+        glUseProgram(compose);
+        glBindTexture(GL_TEXTURE_2D, window);
+        glUniform1i(glGetUniformLocation(compose, "tex"), 0);
+        double frames = measure(duration / 2, [] {
+            glClear(GL_COLOR_BUFFER_BIT);
+            for (int i = 0; i < LAYERS; i++) {
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+        });
+
+        if (glGetError() == GL_NO_ERROR) {
+            result.valid = true;
+            result.renderer = QString::fromLatin1((const char*)glGetString(GL_RENDERER));
+            result.fillRate = quads * mpix;
+            result.composeFps = frames;
+            wmm_info() << "render bench:" << result.renderer << QString("%1x%2").arg(w).arg(h)
+                << "fill" << result.fillRate << "Mpix/s," << "compose" << result.composeFps << "fps";
+        }
+    }
+
+    glDeleteProgram(fill);
+    glDeleteProgram(compose);
+    glDeleteTextures(1, &window);
+    glDeleteTextures(1, &target);
+    glDeleteFramebuffers(1, &fbo);
+
+    eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(dpy, ctx);
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(dpy, surface);
+    eglTerminate(dpy);
+    eglReleaseThread();
+    return result;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * Measures how fast the gpu blends at the size of the screen, in an
+ * offscreen GLES2 context of EGL. The surfaceless platform of mesa is
+ * used when there is one, so it needs no X and runs with llvmpipe too.
+ *
+ * fill rate is from full screen translucent quads, compose fps from
+ * frames of LAYERS full screen textured quads blended on top of each
+ * other, the way a compositor paints a desktop with a few windows.
+ */
+class RenderBench {
+    public:
+        struct Result {
+            bool valid {false};
+            QString renderer;
+            // megapixels per second
+            double fillRate {0};
+            double composeFps {0};
+        };
+
+        /**
+         * runs for about duration ms, returns an invalid result if no
+         * context could be made
+         */
+        static Result run(const QSize& size, int duration);
+
+    private:
+        static const int LAYERS = 3;
+};
+}
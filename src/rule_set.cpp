@@ -0,0 +1,389 @@
+#include "config.h"
+#include "rule_set.h"
+#include "gsettings.h"
+
+// outside of any namespace, as Q_INIT_RESOURCE requires
+static void init_rules_resource()
+{
+    Q_INIT_RESOURCE(rules);
+}
+
+namespace wmm {
+
+static const char* const BUILTIN_RULES = ":/rules.json";
+static const char* const RULE_DIRS[] = {
+    "/usr/share/deepin-wm-switcher/rules.d",
+    "/etc/deepin-wm-switcher/rules.d",
+};
+
+static const char* const XORG_RESULTS[] = {
+    "unreadable",
+    "no_marker",
+    "aiglx_error",
+    "dri_enabled",
+    "swrast",
+};
+
+static const char* const PERMISSIONS[] = {
+    "none",
+    "to_2d",
+    "to_3d",
+    "both",
+};
+
+void RuleSet::load()
+{
+    init_rules_resource();
+
+    _rules.clear();
+    _sources = 0;
+    _identity.clear();
+
+    loadFrom(BUILTIN_RULES);
+    for (const auto& d: RULE_DIRS) {
+        QDir dir(d);
+        for (const auto& name: dir.entryList(QStringList() << "*.json", QDir::Files, QDir::Name)) {
+            loadFrom(dir.filePath(name));
+        }
+    }
+
+    wmm_info() << _rules.size() << "hardware rules loaded";
+}
+
+bool RuleSet::loadFrom(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        wmm_warning() << "can not open rule file" << path;
+        return false;
+    }
+
+    QJsonParseError error;
+    auto doc = QJsonDocument::fromJson(f.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        wmm_warning() << path << error.errorString();
+        return false;
+    }
+
+    auto root = doc.object();
+    int version = root["version"].toInt();
+    if (version < 1 || version > VERSION) {
+        wmm_warning() << path << "has unsupported version" << version;
+        return false;
+    }
+
+    QFileInfo fi(path);
+    _identity.append(QString("%1:%2:%3").arg(path).arg(fi.size())
+            .arg(fi.lastModified().toMSecsSinceEpoch()));
+
+    for (const auto& v: root["rules"].toArray()) {
+        CompiledRule rule;
+        QString msg;
+        if (!compile(v.toObject(), rule, msg)) {
+            wmm_warning() << QString("%1: skip rule \"%2\": %3").arg(path)
+                .arg(v.toObject()["name"].toString()).arg(msg);
+            continue;
+        }
+        _rules.push_back(rule);
+    }
+
+    return true;
+}
+
+int RuleSet::wmIndex(const QString& id)
+{
+    // roles keep rules working with any ladder
+    if (id == "3d") return int(good_wm - wms.begin());
+    if (id == "2d") return int(bad_wm - wms.begin());
+
+    auto wm = find_wm(id);
+    return wm == wms.end() ? -1 : int(wm - wms.begin());
+}
+
+bool RuleSet::compile(const QJsonObject& obj, CompiledRule& rule, QString& error)
+{
+    rule.name = obj["name"].toString();
+    if (rule.name.isEmpty()) {
+        error = "no name";
+        return false;
+    }
+
+    if (!compile(obj["match"].toObject(), rule.match, error)) {
+        return false;
+    }
+
+    if (obj.contains("vote")) {
+        rule.vote = wmIndex(obj["vote"].toString());
+        if (rule.vote < 0) {
+            error = "unknown wm " + obj["vote"].toString();
+            return false;
+        }
+    }
+
+    auto env = obj["env"].toObject();
+    for (auto it = env.constBegin(); it != env.constEnd(); ++it) {
+        rule.env.insert(it.key(), it.value().toVariant().toString());
+    }
+
+    if (obj.contains("permission")) {
+        QString perm = obj["permission"].toString();
+        for (int i = 0; i < int(sizeof PERMISSIONS / sizeof PERMISSIONS[0]); i++) {
+            if (perm == PERMISSIONS[i]) rule.permission = i;
+        }
+        if (rule.permission < 0) {
+            error = "unknown permission " + perm;
+            return false;
+        }
+    }
+
+    for (const auto& v: obj["gsettings"].toArray()) {
+        auto args = v.toVariant().toStringList();
+        if (args.size() != 3) {
+            error = "gsettings wants schema, key and value";
+            return false;
+        }
+        rule.gsettings.append(args);
+    }
+
+    return true;
+}
+
+bool RuleSet::compile(const QJsonObject& obj, Condition& cond, QString& error)
+{
+    static const QStringList known = {
+        "arch", "pci", "pci_vga", "modules", "drm_driver", "x_gpu", "x_driver", "hybrid",
+        "gl_renderer", "fill_rate_below", "compose_fps_below", "xorg_log", "voted", "unless"
+    };
+    // a typo must not turn into a rule that matches everything
+    for (const auto& key: obj.keys()) {
+        if (!known.contains(key)) {
+            error = "unknown condition " + key;
+            return false;
+        }
+    }
+
+    if (obj.contains("arch")) {
+        cond.hasArch = true;
+        cond.arch.setPattern(obj["arch"].toString());
+        cond.arch.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        if (!cond.arch.isValid()) {
+            error = "bad arch regex: " + cond.arch.errorString();
+            return false;
+        }
+        cond.arch.optimize();
+        _sources |= Machine;
+    }
+
+    if (!compilePci(obj["pci"], cond.pci, error)
+            || !compilePci(obj["pci_vga"], cond.pciVga, error)) {
+        return false;
+    }
+    if (!cond.pci.isEmpty() || !cond.pciVga.isEmpty()) {
+        _sources |= Pci;
+    }
+
+    cond.modules = obj["modules"].toVariant().toStringList();
+    if (!cond.modules.isEmpty()) {
+        _sources |= Modules;
+    }
+
+    cond.drm = obj["drm_driver"].toVariant().toStringList();
+    if (!cond.drm.isEmpty()) {
+        // falls back to pci drivers and modules without drm cards
+        _sources |= Drm | Pci | Modules;
+    }
+
+    if (!compilePci(obj["x_gpu"], cond.xGpu, error)) {
+        return false;
+    }
+    cond.xDriver = obj["x_driver"].toVariant().toStringList();
+    if (obj.contains("hybrid")) {
+        cond.hybrid = obj["hybrid"].toBool() ? 1 : 0;
+    }
+    if (!cond.xGpu.isEmpty() || !cond.xDriver.isEmpty() || cond.hybrid >= 0) {
+        _sources |= Gpu | Pci;
+    }
+
+    if (obj.contains("gl_renderer")) {
+        cond.hasRenderer = true;
+        cond.renderer.setPattern(obj["gl_renderer"].toString());
+        cond.renderer.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        if (!cond.renderer.isValid()) {
+            error = "bad gl_renderer regex: " + cond.renderer.errorString();
+            return false;
+        }
+        _sources |= Render;
+    }
+    cond.fillRateBelow = obj["fill_rate_below"].toDouble();
+    cond.composeFpsBelow = obj["compose_fps_below"].toDouble();
+    if (cond.fillRateBelow > 0 || cond.composeFpsBelow > 0) {
+        _sources |= Render;
+    }
+
+    for (const auto& name: obj["xorg_log"].toVariant().toStringList()) {
+        int bit = -1;
+        for (int i = 0; i < int(sizeof XORG_RESULTS / sizeof XORG_RESULTS[0]); i++) {
+            if (name == XORG_RESULTS[i]) bit = i;
+        }
+        if (bit < 0) {
+            error = "unknown xorg_log marker " + name;
+            return false;
+        }
+        cond.xorgLog |= 1 << bit;
+        _sources |= Xorg;
+    }
+
+    if (obj.contains("voted")) {
+        QString voted = obj["voted"].toString();
+        if (voted == "3d" || voted == "2d") {
+            cond.votedRole = voted == "3d";
+        } else if ((cond.voted = wmIndex(voted)) < 0) {
+            error = "unknown wm " + obj["voted"].toString();
+            return false;
+        }
+    }
+
+    for (const auto& v: obj["unless"].toArray()) {
+        Condition sub;
+        if (!compile(v.toObject(), sub, error)) {
+            return false;
+        }
+        cond.unless.push_back(sub);
+    }
+
+    return true;
+}
+
+bool RuleSet::compilePci(const QJsonValue& val, QVector<PciMatch>& out, QString& error)
+{
+    for (const auto& id: val.toVariant().toStringList()) {
+        auto parts = id.split(':');
+        bool ok = parts.size() <= 2;
+        PciMatch m {0, 0xffff0000};
+        if (ok) {
+            m.id = quint32(parts[0].toUShort(&ok, 16)) << 16;
+        }
+        if (ok && parts.size() == 2) {
+            m.id |= parts[1].toUShort(&ok, 16);
+            m.mask = 0xffffffff;
+        }
+        if (!ok) {
+            error = "bad pci id " + id;
+            return false;
+        }
+        out.append(m);
+    }
+    return true;
+}
+
+bool RuleSet::anyPci(const QVector<quint32>& devices, const QVector<PciMatch>& ids)
+{
+    for (auto dev: devices) {
+        for (const auto& m: ids) {
+            if ((dev & m.mask) == m.id) return true;
+        }
+    }
+    return false;
+}
+
+bool RuleSet::matches(const Condition& cond, const HardwareFacts& facts,
+        const QVector<quint32>& cards, const QVector<quint32>& vgas, int voted) const
+{
+    if (cond.voted >= 0 && cond.voted != voted) return false;
+    if (cond.votedRole >= 0 && wms[voted].is3D != bool(cond.votedRole)) return false;
+    if (cond.hasArch && !cond.arch.match(facts.machine).hasMatch()) return false;
+    if (cond.xorgLog && !(cond.xorgLog & (1 << facts.xorgLog))) return false;
+    if (!cond.pci.isEmpty() && !anyPci(cards, cond.pci)) return false;
+    if (!cond.pciVga.isEmpty() && !anyPci(vgas, cond.pciVga)) return false;
+
+    for (const auto& m: cond.modules) {
+        if (!facts.modules.contains(m)) return false;
+    }
+
+    if (!cond.drm.isEmpty()) {
+        bool found = false;
+        if (!facts.drmDrivers.isEmpty()) {
+            for (const auto& drv: facts.drmDrivers) {
+                found = found || cond.drm.contains(drv);
+            }
+        } else {
+            // drm info is unreadable, try pci drivers and modules
+            for (const auto& dev: facts.cards) {
+                found = found || cond.drm.contains(dev.driver);
+            }
+            for (const auto& m: cond.drm) {
+                found = found || facts.modules.contains(m);
+            }
+        }
+        if (!found) return false;
+    }
+
+    if (!cond.xGpu.isEmpty() || !cond.xDriver.isEmpty()) {
+        auto* gpu = GpuInventory::primary(facts.gpus);
+        // drivers like fglrx may not show up in the drm class, a single
+        // vga card is what X uses then
+        GpuDevice only;
+        if (!gpu && vgas.size() == 1) {
+            for (const auto& dev: facts.cards) {
+                if (!dev.isVGA()) continue;
+                only.vendor_id = dev.vendor_id;
+                only.dev_id = dev.dev_id;
+                only.driver = dev.driver;
+                gpu = &only;
+            }
+        }
+        if (!gpu) return false;
+        if (!cond.xGpu.isEmpty() && !anyPci({gpu->pciId()}, cond.xGpu)) return false;
+        if (!cond.xDriver.isEmpty() && !cond.xDriver.contains(gpu->driver)) return false;
+    }
+    if (cond.hybrid >= 0 && GpuInventory::isHybrid(facts.gpus) != bool(cond.hybrid)) return false;
+
+    // nothing is known of a bench which did not run
+    if (cond.hasRenderer || cond.fillRateBelow > 0 || cond.composeFpsBelow > 0) {
+        const auto& bench = facts.render;
+        if (!bench.valid) return false;
+        if (cond.hasRenderer && !cond.renderer.match(bench.renderer).hasMatch()) return false;
+        if (cond.fillRateBelow > 0 && bench.fillRate >= cond.fillRateBelow) return false;
+        if (cond.composeFpsBelow > 0 && bench.composeFps >= cond.composeFpsBelow) return false;
+    }
+
+    for (const auto& sub: cond.unless) {
+        if (matches(sub, facts, cards, vgas, voted)) return false;
+    }
+
+    return true;
+}
+
+void RuleSet::evaluate(const HardwareFacts& facts, WMPointer& vote,
+        SwitchingPermission& permission, QList<RuleResult>& matched) const
+{
+    QVector<quint32> cards, vgas;
+    for (const auto& dev: facts.cards) {
+        quint32 id = quint32(dev.vendor()) << 16 | dev.dev_id.toUShort(nullptr, 16);
+        cards.append(id);
+        if (dev.isVGA()) vgas.append(id);
+    }
+
+    for (const auto& rule: _rules) {
+        if (!matches(rule.match, facts, cards, vgas, int(vote - wms.begin()))) {
+            continue;
+        }
+
+        wmm_info() << "match rule" << rule.name;
+        if (rule.vote >= 0) {
+            vote = wms.begin() + rule.vote;
+        }
+        if (rule.permission >= 0) {
+            permission = static_cast<SwitchingPermission>(rule.permission);
+        }
+        vote->env.insert(rule.env);
+
+        for (const auto& args: rule.gsettings) {
+            gsettings_set_async(args[0], args[1], args[2]);
+        }
+
+        matched.append({rule.name, C2Q(vote->id), rule.env});
+    }
+}
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vector>
+
+#include <QtCore>
+
+#include "window_manager.h"
+#include "hw_probe.h"
+#include "gpu_inventory.h"
+#include "render_bench.h"
+#include "xorg_log.h"
+#include "probe_cache.h"
+
+namespace wmm {
+/**
+ * facts rules are matched against. sources no rule asks for are left
+ * empty.
+ */
+struct HardwareFacts {
+    QString machine;
+    QString kernel;
+    QList<PciDevice> cards;
+    QSet<QString> modules;
+    QStringList drmDrivers;
+    QList<GpuDevice> gpus;
+    // only valid when the bench is enabled and could run
+    RenderBench::Result render;
+    XorgLog::Result xorgLog {XorgLog::NoMarker};
+    // XorgLog::serverIdentity(), read even when the log is not
+    QString xorgBinary;
+};
+
+/**
+ * Hardware rules read from json files and compiled once into a flat
+ * list of pre-parsed conditions, so evaluating them is a few integer
+ * and set lookups per rule.
+ *
+ *  {
+ *    "version": 1,
+ *    "rules": [{
+ *      "name": "...",
+ *      "match": {
+ *        "arch": "regex searched in uname machine",
+ *        "pci": ["vvvv", "vvvv:dddd"],      any video card
+ *        "pci_vga": ["vvvv"],               vga controllers only
+ *        "modules": ["name"],               all loaded
+ *        "drm_driver": ["name"],            any enabled drm card
+ *        "x_gpu": ["vvvv", "vvvv:dddd"],    the gpu X renders with
+ *        "x_driver": ["name"],              its kernel driver
+ *        "hybrid": true,                    more than one enabled gpu
+ *        "gl_renderer": "regex",            searched in GL_RENDERER
+ *        "fill_rate_below": 800,            Mpix/s of the render bench
+ *        "compose_fps_below": 30,           frames/s of the render bench
+ *        "xorg_log": ["unreadable", "no_marker", "aiglx_error",
+ *                     "dri_enabled", "swrast"],
+ *        "voted": "wm id or role voted by earlier rules",
+ *        "unless": [{ match }, ...]         none of them may match
+ *      },
+ *      "vote": "wm id",                     a rung of the wm ladder, or
+ *                                           "3d"/"2d" for good/bad_wm
+ *      "env": { "NAME": "value" },          for the wm voted afterwards
+ *      "permission": "none|to_2d|to_3d|both",
+ *      "gsettings": [["schema", "key", "value"]]
+ *    }]
+ *  }
+ *
+ * Rules run in order and later votes override earlier ones. Built in
+ * rules come first, then *.json from the rules.d dirs under
+ * /usr/share/deepin-wm-switcher and /etc/deepin-wm-switcher sorted by
+ * name, so quirks can be shipped without a rebuild. A rule that does
+ * not compile is skipped as a whole.
+ */
+class RuleSet {
+    public:
+        static const int VERSION = 1;
+
+        enum Source {
+            Machine = 0x01,
+            Pci = 0x02,
+            Modules = 0x04,
+            Drm = 0x08,
+            Xorg = 0x10,
+            Gpu = 0x20,
+            Render = 0x40,
+        };
+
+        /**
+         * built in rules and all drop-in files
+         */
+        void load();
+        bool loadFrom(const QString& path);
+
+        /**
+         * Source bits needed by the loaded rules
+         */
+        int sources() const { return _sources; }
+        /**
+         * path, size and mtime of every file loaded, for the probe cache
+         */
+        QString identity() const { return _identity.join(';'); }
+
+        /**
+         * run all rules, starting from vote. matched rules are
+         * appended to matched.
+         */
+        void evaluate(const HardwareFacts& facts, WMPointer& vote,
+                SwitchingPermission& permission, QList<RuleResult>& matched) const;
+
+    private:
+        struct PciMatch {
+            quint32 id;
+            quint32 mask;
+        };
+
+        struct Condition {
+            bool hasArch {false};
+            QRegularExpression arch;
+            QVector<PciMatch> pci;
+            QVector<PciMatch> pciVga;
+            QStringList modules;
+            QStringList drm;
+            QVector<PciMatch> xGpu;
+            QStringList xDriver;
+            // -1 if not asked
+            int hybrid {-1};
+            bool hasRenderer {false};
+            QRegularExpression renderer;
+            // 0 if not asked
+            double fillRateBelow {0};
+            double composeFpsBelow {0};
+            // bit per XorgLog::Result
+            int xorgLog {0};
+            int voted {-1};
+            // 1 for any 3d rung, 0 for any 2d one
+            int votedRole {-1};
+            std::vector<Condition> unless;
+        };
+
+        struct CompiledRule {
+            QString name;
+            Condition match;
+            // index into wms
+            int vote {-1};
+            QProcessEnvironment env;
+            int permission {-1};
+            QVector<QStringList> gsettings;
+        };
+
+        std::vector<CompiledRule> _rules;
+        int _sources {0};
+        QStringList _identity;
+
+        bool compile(const QJsonObject& obj, CompiledRule& rule, QString& error);
+        bool compile(const QJsonObject& obj, Condition& cond, QString& error);
+        bool compilePci(const QJsonValue& val, QVector<PciMatch>& out, QString& error);
+        static int wmIndex(const QString& id);
+        static bool anyPci(const QVector<quint32>& devices, const QVector<PciMatch>& ids);
+
+        bool matches(const Condition& cond, const HardwareFacts& facts,
+                const QVector<quint32>& cards, const QVector<quint32>& vgas, int voted) const;
+};
+}
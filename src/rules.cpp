@@ -0,0 +1,403 @@
+#include "config.h"
+#include "rules.h"
+#include "probe_cache.h"
+#include "xorg_log.h"
+#include "metrics.h"
+#include "rule_set.h"
+
+#include <memory>
+#include <functional>
+
+#include <QX11Info>
+#include <QGuiApplication>
+#include <QScreen>
+
+using namespace std;
+
+namespace wmm {
+
+struct Card {
+    QString vendor_id;
+    QString dev_id;
+};
+bool operator==(const Card& self, const Card &other) {
+    return self.vendor_id == other.vendor_id && self.dev_id == other.dev_id;
+}
+
+QDebug operator<<(QDebug debug, const Card &c) {
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "[" << c.vendor_id << ":" << c.dev_id << "]";
+    return debug;
+}
+
+HardwareProbe global_probe;
+GpuInventory global_gpus(global_probe);
+
+/**
+ * remembers the video cards of the last session in cards.ini
+ */
+class Settings: public QObject {
+    public:
+        explicit Settings(const QList<PciDevice>& found) {
+            QString config_base = QStandardPaths::writableLocation(
+                    QStandardPaths::ConfigLocation);
+            if (config_base.isEmpty()) {
+                config_base = QString("%1/.config").arg(QDir::homePath());
+            }
+
+            _cfgFilePath = QString("%1/deepin/deepin-wm-switcher/cards.ini").arg(config_base);
+
+            auto l2 = loadEnv(found);
+            if (_cfgFilePath.exists()) {
+                auto l1 = loadSettings();
+                _changed = l1 != l2;
+            }
+            saveSettings(l2);
+        }
+        
+        bool isCardsChanged() const { return _changed; }
+
+    private:
+        QFileInfo _cfgFilePath;
+        bool _changed {false};
+        
+
+        void saveSettings(const QList<Card>& cards) {
+            QSettings cfg(_cfgFilePath.filePath(), QSettings::NativeFormat);
+            cfg.clear();
+            cfg.beginWriteArray("cards");
+            for (int i = 0; i < cards.size(); ++i) {
+                cfg.setArrayIndex(i);
+                cfg.setValue("vendor_id", cards[i].vendor_id);
+                cfg.setValue("dev_id", cards[i].dev_id);
+            }
+            cfg.endArray();
+            qDebug() << "save cards" << cards;
+            cfg.sync();
+        }
+
+        QList<Card> loadSettings() {
+            QList<Card> cards;
+
+            QSettings cfg(_cfgFilePath.filePath(), QSettings::NativeFormat);
+            int size = cfg.beginReadArray("cards");
+            for (int i = 0; i < size; ++i) {
+                cfg.setArrayIndex(i);
+                Card c;
+                c.vendor_id = cfg.value("vendor_id").toString();
+                c.dev_id = cfg.value("dev_id").toString();
+                cards.append(c);
+            }
+            cfg.endArray();
+
+            qDebug() << "load cards" << cards;
+            return cards;
+        }
+
+        QList<Card> loadEnv(const QList<PciDevice>& found) {
+            QList<Card> cards;
+            for (const auto& dev: found) {
+                cards.append({dev.vendor_id, dev.dev_id});
+            }
+
+            wmm_info() << "found cards" << cards;
+            return cards;
+        }
+};
+
+
+Config global_config;
+
+class Rule {
+    public:
+        virtual ~Rule() {}
+        /**
+         * do some test and may change supported wm
+         */
+        virtual void doTest(WMPointer base) = 0;
+        virtual string name() = 0;
+        /**
+         * wm that this Rule recommends most
+         */
+        virtual WMPointer getSupport() = 0;
+        /**
+         * some changes needed in the environment
+         */
+        virtual QProcessEnvironment additionalEnv() {
+            return QProcessEnvironment();
+        }
+};
+
+class ConfigChecker: public Rule {
+    public:
+        explicit ConfigChecker(bool cardsChanged): _cardsChanged(cardsChanged) {}
+
+        void doTest(WMPointer base) override {
+            _voted = base;
+            global_config.load();
+
+            // if cards list changed, use probed result instead of config
+            // (which might be stale at this moment).
+            if (_cardsChanged) {
+                wmm_info() << "detect cards changed, ignore config";
+                global_config.selectWM(C2Q(_voted->id));
+                global_config.setAllowSwitch(switch_permission != ALLOW_NONE);
+                return;
+            }
+
+            QString saved = global_config.currentWM();
+            if (!global_config.allowSwitch()) {
+                switch_permission = ALLOW_NONE;
+            }
+            auto wm = find_wm(saved);
+            if (wm != wms.end()) {
+                _voted = wm;
+            }
+        }
+
+        WMPointer getSupport() override {
+            return _voted;
+        }
+
+        string name() override {
+            return "config";
+        }
+
+    private:
+        bool _cardsChanged;
+        WMPointer _voted { wms.end() };
+};
+
+struct ProbeJob {
+    QString name;
+    // RuleSet::Source bit of the fields fill() sets
+    int source;
+    function<void(HardwareFacts&)> fill;
+};
+
+static void merge_facts(HardwareFacts& to, const HardwareFacts& from, int source) {
+    switch (source) {
+        case RuleSet::Machine: to.machine = from.machine; to.kernel = from.kernel; break;
+        case RuleSet::Pci: to.cards = from.cards; break;
+        case RuleSet::Modules: to.modules = from.modules; break;
+        case RuleSet::Drm: to.drmDrivers = from.drmDrivers; break;
+        case RuleSet::Xorg:
+            // the server identity and the log are read by separate jobs
+            if (from.xorgBinary.isEmpty()) {
+                to.xorgLog = from.xorgLog;
+            } else {
+                to.xorgBinary = from.xorgBinary;
+            }
+            break;
+        case RuleSet::Gpu: to.gpus = from.gpus; break;
+        case RuleSet::Render: to.render = from.render; break;
+        default: break;
+    }
+}
+
+/**
+ * owned by gather_facts and all of its tasks together, a task which
+ * hangs past the deadline keeps it alive but merges nothing any more.
+ */
+struct ProbeState {
+    QMutex lock;
+    QWaitCondition cond;
+    int pending {0};
+    bool abandoned {false};
+    HardwareFacts facts;
+};
+
+class ProbeTask: public QRunnable {
+    public:
+        ProbeTask(const ProbeJob& job, const shared_ptr<ProbeState>& state)
+            :_job(job), _state(state) {}
+
+        void run() override {
+            QElapsedTimer t;
+            t.start();
+            // filled in private, merged under the lock
+            HardwareFacts local;
+            _job.fill(local);
+            Metrics::instance().observe("wmm_probe_duration_ms",
+                    Metrics::label("source", _job.name), t.elapsed());
+
+            QMutexLocker locker(&_state->lock);
+            if (!_state->abandoned) {
+                merge_facts(_state->facts, local, _job.source);
+            }
+            _state->pending--;
+            _state->cond.wakeAll();
+        }
+
+    private:
+        ProbeJob _job;
+        shared_ptr<ProbeState> _state;
+};
+
+/**
+ * read sources in parallel and add them to facts, waiting at most
+ * timeout ms. false if some did not finish in time.
+ */
+static bool gather_facts(const vector<ProbeJob>& jobs, HardwareFacts& facts, int timeout) {
+    // a hung read keeps its thread, never deleted so that exit does
+    // not wait for it
+    static QThreadPool* pool = new QThreadPool;
+    pool->setMaxThreadCount(qMax(pool->activeThreadCount() + int(jobs.size()), 1));
+
+    auto state = make_shared<ProbeState>();
+    state->pending = jobs.size();
+    state->facts = facts;
+    for (const auto& job: jobs) {
+        pool->start(new ProbeTask(job, state));
+    }
+
+    QElapsedTimer t;
+    t.start();
+    QMutexLocker locker(&state->lock);
+    while (state->pending > 0 && t.elapsed() < timeout) {
+        // elapsed may have passed timeout since the check, a negative
+        // wait would be taken as unsigned, that is forever
+        state->cond.wait(&state->lock, qMax<qint64>(1, timeout - t.elapsed()));
+    }
+
+    state->abandoned = true;
+    facts = state->facts;
+    return state->pending == 0;
+}
+
+/**
+ * replay a probe result saved by an earlier session
+ */
+static bool restore_probe_result(const ProbeResult& result, WMPointer& p) {
+    auto decision = find_wm(result.decision);
+    if (decision == wms.end()) {
+        return false;
+    }
+
+    for (const auto& r: result.rules) {
+        auto wm = find_wm(r.wm);
+        if (wm != wms.end()) {
+            wm->env.insert(r.env);
+        }
+    }
+
+    switch_permission = static_cast<SwitchingPermission>(result.permission);
+    p = decision;
+    return true;
+}
+
+// what hardware allows, before config had its say
+static SwitchingPermission probed_permission = ALLOW_NONE;
+
+WMPointer apply_rules() {
+    // rules which only depend on hardware, their outcome is cached
+    RuleSet rules;
+    rules.load();
+
+    QString xorglog = XorgLog::locate(QX11Info::appScreen());
+    int sources = rules.sources();
+
+    // what the cache is keyed on is read first, the rest only if the
+    // cache misses. both share the deadline.
+    vector<ProbeJob> identity = {
+        {"machine", RuleSet::Machine, [](HardwareFacts& f) {
+            f.machine = global_probe.machine();
+            f.kernel = global_probe.kernelRelease();
+        }},
+        {"pci", RuleSet::Pci, [](HardwareFacts& f) { f.cards = global_probe.videoCards(); }},
+        {"drm", RuleSet::Drm, [](HardwareFacts& f) { f.drmDrivers = global_probe.drmDrivers(); }},
+        {"xorg", RuleSet::Xorg, [](HardwareFacts& f) { f.xorgBinary = XorgLog::serverIdentity(); }},
+    };
+
+    vector<ProbeJob> jobs;
+    // the log is rewritten on every start and may be huge, a hit goes
+    // by the server identity instead
+    if (sources & RuleSet::Xorg) {
+        jobs.push_back({"xorg_log", RuleSet::Xorg, [xorglog](HardwareFacts& f) {
+            wmm_info() << "check " << xorglog;
+            f.xorgLog = XorgLog::scan(xorglog);
+        }});
+    }
+    if (sources & RuleSet::Modules) {
+        jobs.push_back({"modules", RuleSet::Modules, [](HardwareFacts& f) { f.modules = global_probe.modules(); }});
+    }
+    if (sources & RuleSet::Gpu) {
+        global_gpus.setXConnection(QX11Info::connection(), QX11Info::appRootWindow());
+        jobs.push_back({"gpu", RuleSet::Gpu, [](HardwareFacts& f) { f.gpus = global_gpus.devices(); }});
+    }
+    // the bench is optional, rules asking for it do not match without
+    QString cacheKey = rules.identity() + '|' + ladder_identity();
+    auto bench = global_config.value("render_bench").toObject();
+    if ((sources & RuleSet::Render) && bench["enabled"].toBool(false)) {
+        QSize size = qApp->primaryScreen()->virtualSize();
+        int duration = qBound(100, bench["duration"].toInt(400), 2000);
+        jobs.push_back({"render", RuleSet::Render, [size, duration](HardwareFacts& f) {
+            f.render = RenderBench::run(size, duration);
+        }});
+        // it measures at the size of the screen
+        cacheKey += QString("|render:%1x%2").arg(size.width()).arg(size.height());
+    }
+
+    for (auto& wm: wms) {
+        wm.env = wm.configuredEnv;
+    }
+
+    WindowManagerList::iterator p = good_wm;
+
+    ProbeCache cache;
+    bool cached = cache.load();
+    int timeout = global_config.probeTimeout();
+    QElapsedTimer elapsed;
+    elapsed.start();
+    HardwareFacts facts;
+    bool known = gather_facts(identity, facts, timeout);
+    auto fp = ProbeCache::fingerprint(facts, cacheKey);
+
+    if (known && cached && cache.isValidFor(fp) && restore_probe_result(cache.result(), p)) {
+        wmm_info() << "hardware unchanged, use cached probe result";
+
+    } else if (!known || !gather_facts(jobs, facts, timeout - elapsed.elapsed())) {
+        // fall back to the last known good decision, or the 2d wm
+        // when nothing is known, since a hung probe usually means
+        // the graphics hardware is in a bad state.
+        if (!cached || !restore_probe_result(cache.result(), p)) {
+            p = bad_wm;
+            switch_permission = ALLOW_BOTH;
+        }
+        wmm_warning() << QString("probing takes longer than %1ms, fallback to %2")
+            .arg(timeout).arg(C2Q(p->genericName));
+
+    } else {
+        ProbeResult result;
+        rules.evaluate(facts, p, switch_permission, result.rules);
+
+        result.decision = C2Q(p->id);
+        result.permission = switch_permission;
+        cache.save(fp, result);
+    }
+
+    probed_permission = switch_permission;
+
+    // cards unknown after a timeout are not taken for a change
+    bool cardsChanged = known && Settings(facts.cards).isCardsChanged();
+    ConfigChecker config(cardsChanged);
+    config.doTest(p);
+    p = config.getSupport();
+
+    if (p == wms.end()) {
+        p = good_wm;
+    }
+
+    return p;
+}
+
+WMPointer apply_config() {
+    switch_permission = probed_permission;
+    if (!global_config.allowSwitch()) {
+        switch_permission = ALLOW_NONE;
+    }
+
+    return find_wm(global_config.currentWM());
+}
+
+}
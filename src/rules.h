@@ -0,0 +1,24 @@
+#pragma once
+
+#include "window_manager.h"
+#include "hw_probe.h"
+#include "gpu_inventory.h"
+#include "config_manager.h"
+
+namespace wmm {
+extern HardwareProbe global_probe;
+extern GpuInventory global_gpus;
+extern Config global_config;
+
+/**
+ * probe hardware, run all rules and pick the wm to start with. it also
+ * fills switch_permission and the extra env of each wm.
+ */
+WMPointer apply_rules();
+
+/**
+ * apply the current config on top of the result of the last
+ * apply_rules(). returns the wm config asks for, or wms.end().
+ */
+WMPointer apply_config();
+}
@@ -0,0 +1,69 @@
+#include "config.h"
+#include "switch_timer.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+namespace wmm {
+
+const char* SwitchTimer::phaseName(int phase)
+{
+    static const char* names[] = {
+        "requested",
+        "old_terminated",
+        "new_started",
+        "selection_owned",
+        "post_actions_done",
+    };
+    return phase >= 0 && phase < PhaseCount ? names[phase] : "";
+}
+
+void SwitchTimer::begin(const QString& wm)
+{
+    _wm = wm;
+    _clock.start();
+    std::fill(_marks, _marks + PhaseCount, -1);
+    _marks[Requested] = 0;
+}
+
+void SwitchTimer::mark(Phase phase)
+{
+    if (!inProgress() || _marks[phase] >= 0) return;
+
+    _marks[phase] = _clock.elapsed();
+    if (_marks[SelectionOwned] >= 0 && _marks[PostActionsDone] >= 0) {
+        finish();
+    }
+}
+
+void SwitchTimer::finish()
+{
+    auto& hs = _histograms[_wm];
+    if (hs.isEmpty()) hs.resize(PhaseCount);
+
+    _last.clear();
+    _last["wm"] = _wm;
+    for (int i = 0; i < PhaseCount; i++) {
+        if (_marks[i] < 0) continue;
+        _last[phaseName(i)] = _marks[i];
+        hs[i].observe(_marks[i]);
+    }
+
+    qint64 total = *std::max_element(_marks, _marks + PhaseCount);
+    _last["total"] = total;
+    Metrics::instance().observe("wmm_switch_latency_ms", Metrics::label("wm", _wm), total);
+    wmm_info() << "switch to" << _wm << "took" << total << "ms";
+    _clock.invalidate();
+}
+
+QVariantMap SwitchTimer::histograms(const QString& wm) const
+{
+    QVariantMap m;
+    auto hs = _histograms.value(wm);
+    for (int i = 0; i < hs.size(); i++) {
+        m[phaseName(i)] = hs[i].toVariantMap();
+    }
+    return m;
+}
+
+}
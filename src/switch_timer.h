@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QtCore>
+#include "histogram.h"
+
+namespace wmm {
+/**
+ * Timestamps the phases of a wm switch relative to the moment it was
+ * requested, and keeps a histogram per target wm and phase.
+ */
+class SwitchTimer {
+    public:
+        enum Phase {
+            Requested,
+            OldTerminated,
+            NewStarted,
+            SelectionOwned,
+            PostActionsDone,
+            PhaseCount
+        };
+
+        /**
+         * start timing a switch to wm, any unfinished one is dropped
+         */
+        void begin(const QString& wm);
+        void mark(Phase phase);
+        bool inProgress() const { return _clock.isValid(); }
+
+        /**
+         * phases of the last finished switch in ms
+         */
+        QVariantMap last() const { return _last; }
+        QVariantMap histograms(const QString& wm) const;
+
+        static const char* phaseName(int phase);
+
+    private:
+        QElapsedTimer _clock;
+        QString _wm;
+        qint64 _marks[PhaseCount];
+        QVariantMap _last;
+        QHash<QString, QVector<Histogram>> _histograms;
+
+        void finish();
+};
+}
@@ -0,0 +1,90 @@
+#include "config.h"
+#include "window_manager.h"
+
+#include <algorithm>
+
+namespace wmm {
+
+// all in one unit, good_wm and bad_wm point into wms
+WindowManagerList wms = {
+    {"deepin wm", "deepin-wm", {}, "deepin-wm", 100, true, {}},
+    {"deepin metacity", "deepin-metacity", {}, "deepin-metacity", 30, false, {}},
+};
+
+WMPointer good_wm = wms.begin();
+WMPointer bad_wm = wms.begin() + 1;
+SwitchingPermission switch_permission = ALLOW_NONE;
+
+bool load_ladder(const QJsonArray& ladder)
+{
+    if (ladder.isEmpty()) return false;
+
+    WindowManagerList rungs;
+    QSet<QString> ids;
+    for (const auto& v: ladder) {
+        auto obj = v.toObject();
+        QString exec = obj["exec"].toString();
+        QString id = obj["id"].toString(exec);
+        if (exec.isEmpty() || ids.contains(id)) {
+            wmm_warning() << "bad wm ladder rung" << id << ", use the built in ladder";
+            return false;
+        }
+        ids.insert(id);
+
+        QProcessEnvironment env;
+        auto vars = obj["env"].toObject();
+        for (auto it = vars.constBegin(); it != vars.constEnd(); ++it) {
+            env.insert(it.key(), it.value().toVariant().toString());
+        }
+
+        rungs.push_back({obj["name"].toString(id).toStdString(), exec.toStdString(), env,
+                id.toStdString(), obj["cost"].toInt(), obj["3d"].toBool(false), env});
+    }
+
+    // stable, equal costs keep their configured order
+    std::stable_sort(rungs.begin(), rungs.end(), [](const WindowManager& a, const WindowManager& b) {
+        return a.cost > b.cost;
+    });
+
+    wms = rungs;
+    good_wm = wms.begin();
+    bad_wm = std::find_if(wms.begin(), wms.end(), [](const WindowManager& wm) {
+        return !wm.is3D;
+    });
+    if (bad_wm == wms.end()) {
+        bad_wm = wms.end() - 1;
+    }
+
+    for (const auto& wm: wms) {
+        wmm_info() << "wm ladder:" << C2Q(wm.id) << "cost" << wm.cost << (wm.is3D ? "3d" : "2d");
+    }
+    return true;
+}
+
+QString ladder_identity()
+{
+    QStringList ids;
+    for (const auto& wm: wms) {
+        ids << C2Q(wm.id);
+    }
+    return ids.join(',');
+}
+
+WMPointer find_wm(const QString& id)
+{
+    return std::find_if(wms.begin(), wms.end(), [&](const WindowManager& wm) {
+        return C2Q(wm.id) == id;
+    });
+}
+
+WMPointer lighter_wm(WMPointer wm)
+{
+    return wm == wms.end() || wm + 1 == wms.end() ? wm : wm + 1;
+}
+
+WMPointer heavier_wm(WMPointer wm)
+{
+    return wm == wms.end() || wm == wms.begin() ? wm : wm - 1;
+}
+
+}
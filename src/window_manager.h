@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <QtCore>
+
+#define C2Q(cs) (QString::fromUtf8((cs).c_str()))
+
+namespace wmm {
+/**
+ * a rung of the wm ladder. several rungs may run the same executable
+ * with different environments, so they are told apart by id.
+ */
+struct WindowManager {
+    std::string genericName;
+    std::string execName;
+    QProcessEnvironment env;
+    std::string id;
+    // relative resource cost, rungs are ordered from the heaviest down
+    int cost;
+    bool is3D;
+    // env from the ladder, rules add to it
+    QProcessEnvironment configuredEnv;
+};
+
+using WindowManagerList = std::vector<WindowManager>;
+
+/**
+ * TO_2D allows leaving 3d rungs for 2d ones, TO_3D the other way.
+ * moving between rungs of the same kind is allowed unless NONE.
+ */
+enum SwitchingPermission {
+    ALLOW_NONE,
+    ALLOW_TO_2D,
+    ALLOW_TO_3D,
+    ALLOW_BOTH
+};
+
+using WMPointer = WindowManagerList::iterator;
+
+// the ladder, good_wm is the top rung and bad_wm the topmost 2d one
+extern WindowManagerList wms;
+extern WMPointer good_wm;
+extern WMPointer bad_wm;
+extern SwitchingPermission switch_permission;
+
+/**
+ * replace the built in ladder by the "wm_ladder" config key:
+ *
+ *  [{
+ *    "id": "deepin-metacity-lite",      exec name if not given
+ *    "name": "deepin metacity lite",
+ *    "exec": "deepin-metacity",
+ *    "env": { "META_DEBUG_NO_SHADOW": "1" },
+ *    "cost": 20,
+ *    "3d": false
+ *  }]
+ *
+ * must run before any WMPointer is taken, the ladder is fixed after.
+ * an invalid ladder is ignored as a whole.
+ */
+bool load_ladder(const QJsonArray& ladder);
+/**
+ * ids of all rungs, for caches depending on them
+ */
+QString ladder_identity();
+
+WMPointer find_wm(const QString& id);
+/**
+ * the rung right below or above wm, wm itself at either end
+ */
+WMPointer lighter_wm(WMPointer wm);
+WMPointer heavier_wm(WMPointer wm);
+}
@@ -0,0 +1,197 @@
+#include "config.h"
+#include "wm_selection.h"
+
+#include <QGuiApplication>
+#include <QX11Info>
+
+namespace wmm {
+
+WMSelectionWatcher::WMSelectionWatcher(int screen, QObject* parent)
+    :QObject(parent)
+{
+    _conn = QX11Info::connection();
+    _root = QX11Info::appRootWindow(screen);
+    init(screen);
+
+    qApp->installNativeEventFilter(this);
+}
+
+WMSelectionWatcher::WMSelectionWatcher(const QString& display, QObject* parent)
+    :QObject(parent)
+{
+    int screen = 0;
+    _own = xcb_connect(display.toLatin1().constData(), &screen);
+    if (xcb_connection_has_error(_own)) {
+        wmm_warning() << "can not connect to display" << display;
+        xcb_disconnect(_own);
+        _own = nullptr;
+        return;
+    }
+    _conn = _own;
+
+    auto it = xcb_setup_roots_iterator(xcb_get_setup(_conn));
+    for (int i = 0; i < screen && it.rem; i++) {
+        xcb_screen_next(&it);
+    }
+    _root = it.data->root;
+    init(screen);
+
+    _notifier = new QSocketNotifier(xcb_get_file_descriptor(_conn), QSocketNotifier::Read, this);
+    connect(_notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+    // replies of the queries above may have queued events already
+    QMetaObject::invokeMethod(this, "readEvents", Qt::QueuedConnection);
+}
+
+void WMSelectionWatcher::init(int screen)
+{
+    _selection = intern(QString("WM_S%1").arg(screen).toLatin1());
+    _manager = intern("MANAGER");
+    _supportingCheck = intern("_NET_SUPPORTING_WM_CHECK");
+
+    // MANAGER is sent to root with StructureNotifyMask
+    addEventMask(_root, XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE);
+
+    queryOwner();
+    querySupportingWMCheck();
+}
+
+WMSelectionWatcher::~WMSelectionWatcher()
+{
+    if (_own) {
+        xcb_disconnect(_own);
+    } else if (qApp) {
+        qApp->removeNativeEventFilter(this);
+    }
+}
+
+void WMSelectionWatcher::readEvents()
+{
+    xcb_generic_event_t* ev;
+    while ((ev = xcb_poll_for_event(_conn))) {
+        handleEvent(ev);
+        free(ev);
+    }
+
+    if (xcb_connection_has_error(_conn)) {
+        wmm_warning() << "lost connection to x server";
+        _notifier->setEnabled(false);
+    }
+}
+
+xcb_atom_t WMSelectionWatcher::intern(const QByteArray& name)
+{
+    auto cookie = xcb_intern_atom(_conn, 0, name.size(), name.constData());
+    auto* reply = xcb_intern_atom_reply(_conn, cookie, NULL);
+    if (!reply) {
+        wmm_warning() << "intern atom failed: " << name;
+        return XCB_NONE;
+    }
+
+    xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+void WMSelectionWatcher::addEventMask(xcb_window_t w, uint32_t mask)
+{
+    // the connection may be shared with Qt, keep whatever it selected
+    auto cookie = xcb_get_window_attributes(_conn, w);
+    auto* reply = xcb_get_window_attributes_reply(_conn, cookie, NULL);
+    if (!reply) return;
+
+    uint32_t value = reply->your_event_mask | mask;
+    free(reply);
+
+    xcb_change_window_attributes(_conn, w, XCB_CW_EVENT_MASK, &value);
+    xcb_flush(_conn);
+}
+
+void WMSelectionWatcher::queryOwner()
+{
+    auto cookie = xcb_get_selection_owner(_conn, _selection);
+    auto* reply = xcb_get_selection_owner_reply(_conn, cookie, NULL);
+    xcb_window_t owner = XCB_NONE;
+    if (reply) {
+        owner = reply->owner;
+        free(reply);
+    }
+
+    setOwner(owner);
+}
+
+void WMSelectionWatcher::setOwner(xcb_window_t owner)
+{
+    if (owner == _owner) return;
+
+    _owner = owner;
+    if (_owner != XCB_NONE) {
+        // we learn about the owner going away by its window destroyed
+        addEventMask(_owner, XCB_EVENT_MASK_STRUCTURE_NOTIFY);
+    }
+
+    wmm_info() << "wm selection owner: " << QString::number(_owner, 16);
+    emit ownerChanged(_owner);
+}
+
+void WMSelectionWatcher::querySupportingWMCheck()
+{
+    auto cookie = xcb_get_property(_conn, 0, _root, _supportingCheck, XCB_ATOM_WINDOW, 0, 1);
+    auto* reply = xcb_get_property_reply(_conn, cookie, NULL);
+    xcb_window_t check = XCB_NONE;
+    if (reply) {
+        if (xcb_get_property_value_length(reply) >= (int)sizeof(xcb_window_t)) {
+            check = *(xcb_window_t*)xcb_get_property_value(reply);
+        }
+        free(reply);
+    }
+
+    if (check != _check) {
+        _check = check;
+        emit supportingWMCheckChanged(_check);
+    }
+}
+
+bool WMSelectionWatcher::nativeEventFilter(const QByteArray &eventType, void *message, long *)
+{
+    if (eventType != "xcb_generic_event_t") return false;
+
+    handleEvent(static_cast<xcb_generic_event_t *>(message));
+    return false;
+}
+
+void WMSelectionWatcher::handleEvent(xcb_generic_event_t* ev)
+{
+    switch (ev->response_type & ~0x80) {
+        case XCB_CLIENT_MESSAGE: {
+            auto* cev = (xcb_client_message_event_t *)ev;
+            if (cev->window == _root && cev->type == _manager
+                    && cev->data.data32[1] == _selection) {
+                setOwner(cev->data.data32[2]);
+            }
+            break;
+        }
+
+        case XCB_DESTROY_NOTIFY: {
+            auto* dev = (xcb_destroy_notify_event_t *)ev;
+            if (dev->window == _owner) {
+                // someone may have taken over already
+                queryOwner();
+            }
+            break;
+        }
+
+        case XCB_PROPERTY_NOTIFY: {
+            auto* pev = (xcb_property_notify_event_t *)ev;
+            if (pev->window == _root && pev->atom == _supportingCheck) {
+                querySupportingWMCheck();
+                // not every wm broadcasts MANAGER, catch up here
+                queryOwner();
+            }
+            break;
+        }
+
+        default: break;
+    }
+}
+
+}
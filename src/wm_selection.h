@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QtCore>
+#include <QAbstractNativeEventFilter>
+
+#include <xcb/xcb.h>
+
+namespace wmm {
+/**
+ * Tracks who owns the WM_S<n> selection and _NET_SUPPORTING_WM_CHECK on
+ * the root window, purely from X events on the application connection.
+ *
+ * A new owner announces itself with the ICCCM MANAGER client message,
+ * and losing it is seen as DestroyNotify of the owner's window.
+ *
+ * Displays other than the one Qt is connected to get a connection of
+ * their own, which is read from the event loop.
+ */
+class WMSelectionWatcher: public QObject, public QAbstractNativeEventFilter {
+    Q_OBJECT
+    public:
+        explicit WMSelectionWatcher(int screen, QObject* parent = nullptr);
+        /**
+         * display is in the form of $DISPLAY, like ":1" or ":1.0"
+         */
+        explicit WMSelectionWatcher(const QString& display, QObject* parent = nullptr);
+        ~WMSelectionWatcher();
+
+        bool isValid() const { return _conn != nullptr; }
+
+        xcb_window_t owner() const { return _owner; }
+        xcb_window_t supportingWMCheck() const { return _check; }
+
+        /**
+         * selection is owned and the wm has advertised itself
+         */
+        bool isReady() const { return _owner != XCB_NONE && _check != XCB_NONE; }
+
+        bool nativeEventFilter(const QByteArray &eventType, void *message, long *) Q_DECL_OVERRIDE;
+
+    signals:
+        void ownerChanged(quint32 owner);
+        void supportingWMCheckChanged(quint32 window);
+
+    private slots:
+        void readEvents();
+
+    private:
+        xcb_connection_t* _conn {nullptr};
+        // set when the connection is ours
+        xcb_connection_t* _own {nullptr};
+        QSocketNotifier* _notifier {nullptr};
+        xcb_window_t _root {XCB_NONE};
+        xcb_atom_t _selection {XCB_NONE};
+        xcb_atom_t _manager {XCB_NONE};
+        xcb_atom_t _supportingCheck {XCB_NONE};
+
+        xcb_window_t _owner {XCB_NONE};
+        xcb_window_t _check {XCB_NONE};
+
+        void init(int screen);
+        void handleEvent(xcb_generic_event_t* ev);
+        xcb_atom_t intern(const QByteArray& name);
+        void addEventMask(xcb_window_t w, uint32_t mask);
+
+        void queryOwner();
+        void setOwner(xcb_window_t owner);
+        void querySupportingWMCheck();
+};
+}
@@ -0,0 +1,163 @@
+#include "config.h"
+#include "xorg_log.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+namespace wmm {
+
+// markers never span lines, so chunks always end at a newline
+static const size_t SCAN_CHUNK = 64 * 1024;
+
+struct Marker {
+    const char* text;
+    size_t len;
+    XorgLog::Result result;
+    // check the surroundings of a hit, [begin, end) is the chunk
+    bool (*accept)(const char* begin, const char* hit, const char* end);
+};
+
+// \(EE\)\s+AIGLX error
+static bool accept_aiglx(const char* begin, const char* hit, const char*)
+{
+    const char* p = hit;
+    while (p > begin && (p[-1] == ' ' || p[-1] == '\t')) p--;
+    if (p == hit || p - begin < 4) return false;
+    return memcmp(p - 4, "(EE)", 4) == 0;
+}
+
+// direct rendering: DRI\d+ enabled
+static bool accept_dri(const char*, const char* hit, const char* end)
+{
+    static const char tail[] = " enabled";
+    const char* p = hit + strlen("direct rendering: DRI");
+    const char* digits = p;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    if (p == digits) return false;
+    return (size_t)(end - p) >= sizeof tail - 1 && memcmp(p, tail, sizeof tail - 1) == 0;
+}
+
+static bool accept_any(const char*, const char*, const char*)
+{
+    return true;
+}
+
+static const Marker markers[] = {
+    {"AIGLX error", 11, XorgLog::AiglxError, accept_aiglx},
+    {"direct rendering: DRI", 21, XorgLog::DriEnabled, accept_dri},
+    {"GLX: Initialized DRISWRAST", 26, XorgLog::SwrastUsed, accept_any},
+};
+
+QString XorgLog::locate(int n)
+{
+    QString name = QString("Xorg.%1.log").arg(n);
+    QString system_log = QString("/var/log/%1").arg(name);
+
+    QString data_base = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    if (data_base.isEmpty()) {
+        data_base = QString("%1/.local/share").arg(QDir::homePath());
+    }
+    QFileInfo user_log(QString("%1/xorg/%2").arg(data_base).arg(name));
+    QFileInfo sys(system_log);
+
+    if (user_log.exists() && (!sys.exists() || user_log.lastModified() > sys.lastModified())) {
+        return user_log.filePath();
+    }
+
+    return system_log;
+}
+
+QString XorgLog::serverIdentity()
+{
+    // /usr/bin/Xorg is a wrapper script on debian, the server is here
+    QFileInfo server("/usr/lib/xorg/Xorg");
+    if (!server.exists()) {
+        server.setFile(QStandardPaths::findExecutable("Xorg"));
+    }
+    if (!server.exists()) return QString();
+
+    QStringList stamps;
+    stamps << QString("%1:%2").arg(server.canonicalFilePath())
+        .arg(server.lastModified().toMSecsSinceEpoch());
+
+    // what else decides whether dri comes up. packages replace files by
+    // renaming, which touches the directory too.
+    static const char* paths[] = {
+        "/etc/X11/xorg.conf",
+        "/etc/X11/xorg.conf.d",
+        "/usr/share/X11/xorg.conf.d",
+        "/usr/lib/dri",
+        "/usr/lib64/dri",
+        "/usr/lib/" LIBRARY_ARCHITECTURE "/dri",
+    };
+    for (auto path: paths) {
+        QFileInfo fi(path);
+        if (fi.exists()) {
+            stamps << QString("%1:%2").arg(path).arg(fi.lastModified().toMSecsSinceEpoch());
+        }
+    }
+    return stamps.join('|');
+}
+
+XorgLog::Result XorgLog::scan(const char* data, size_t len)
+{
+    const char* p = data;
+    const char* end = data + len;
+
+    while (p < end) {
+        const char* stop = end;
+        if ((size_t)(end - p) > SCAN_CHUNK) {
+            auto nl = (const char*)memchr(p + SCAN_CHUNK, '\n', end - p - SCAN_CHUNK);
+            if (nl) stop = nl + 1;
+        }
+
+        const char* best = nullptr;
+        Result result = NoMarker;
+        for (const auto& m: markers) {
+            const char* from = p;
+            // only look before the best hit so far
+            const char* limit = best ? best : stop;
+            while (from < limit) {
+                auto hit = (const char*)memmem(from, limit - from, m.text, m.len);
+                if (!hit) break;
+                if (m.accept(p, hit, stop)) {
+                    best = hit;
+                    result = m.result;
+                    break;
+                }
+                from = hit + 1;
+            }
+        }
+
+        if (best) return result;
+        p = stop;
+    }
+
+    return NoMarker;
+}
+
+XorgLog::Result XorgLog::scan(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QFile::ReadOnly)) {
+        return Unreadable;
+    }
+
+    qint64 size = f.size();
+    if (size <= 0) {
+        return NoMarker;
+    }
+
+    uchar* data = f.map(0, size);
+    if (!data) {
+        wmm_warning() << "can not map " << path;
+        return Unreadable;
+    }
+
+    madvise(data, size, MADV_SEQUENTIAL);
+    auto result = scan((const char*)data, size);
+    f.unmap(data);
+    return result;
+}
+
+}
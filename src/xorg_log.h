@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QtCore>
+
+namespace wmm {
+/**
+ * Looks for the markers telling whether Xorg got direct rendering. The
+ * log is memory mapped and searched in place, so no per line strings
+ * are allocated even for logs of tens of MB.
+ */
+class XorgLog {
+    public:
+        enum Result {
+            Unreadable,
+            NoMarker,
+            AiglxError,
+            DriEnabled,
+            SwrastUsed,
+        };
+
+        /**
+         * path of Xorg.n.log, the user's data dir is considered as well
+         * for rootless X. the newest one wins if both exist.
+         */
+        static QString locate(int n);
+
+        /**
+         * the first marker found decides the result
+         */
+        static Result scan(const QString& path);
+        static Result scan(const char* data, size_t len);
+
+        /**
+         * paths and mtimes of the X server binary, its config and the
+         * dri drivers. unlike the log they stay the same from one start
+         * to the next, and a few stats tell whether what the log would
+         * say may have changed.
+         */
+        static QString serverIdentity();
+};
+}
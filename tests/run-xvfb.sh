@@ -0,0 +1,45 @@
+#!/bin/sh
+# Runs a test or the harness on a private Xvfb and session bus, with
+# throw away config, cache and runtime dirs. Exits 77, which ctest
+# takes as skipped, where there is no Xvfb.
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+    echo "Xvfb not found, skip $1"
+    exit 77
+fi
+
+tmp=$(mktemp -d)
+xvfb=
+cleanup() {
+    [ -n "$xvfb" ] && kill "$xvfb" 2>/dev/null
+    rm -rf "$tmp"
+}
+trap cleanup EXIT INT TERM
+
+# Xvfb writes the display number it picked once it is ready
+Xvfb -displayfd 3 -screen 0 1280x800x24 -nolisten tcp 3>"$tmp/display" 2>"$tmp/xvfb.log" &
+xvfb=$!
+for i in $(seq 50); do
+    [ -s "$tmp/display" ] && break
+    sleep 0.1
+done
+if [ ! -s "$tmp/display" ]; then
+    cat "$tmp/xvfb.log" >&2
+    echo "Xvfb did not start" >&2
+    exit 1
+fi
+
+export DISPLAY=":$(cat "$tmp/display")"
+export QT_QPA_PLATFORM=xcb
+export XDG_CONFIG_HOME="$tmp/config"
+export XDG_CACHE_HOME="$tmp/cache"
+export XDG_DATA_HOME="$tmp/data"
+export XDG_RUNTIME_DIR="$tmp/runtime"
+mkdir -p "$XDG_CONFIG_HOME" "$XDG_CACHE_HOME" "$XDG_DATA_HOME"
+mkdir -m 700 "$XDG_RUNTIME_DIR"
+
+if command -v dbus-run-session >/dev/null 2>&1; then
+    dbus-run-session -- "$@"
+else
+    "$@"
+fi
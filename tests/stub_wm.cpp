@@ -0,0 +1,282 @@
+/**
+ * A window manager that manages nothing, for the tests and the harness.
+ * It takes WM_S<n> the ICCCM way, honours --replace, advertises itself
+ * through _NET_SUPPORTING_WM_CHECK and leaves when another wm takes the
+ * selection, which is all the switcher looks at.
+ *
+ * What it does besides is told by the environment, so that a rung of
+ * the wm ladder can pick it with "env":
+ *
+ *   STUB_WM_NAME          _NET_WM_NAME of the check window
+ *   STUB_WM_MODE          run (default), crash, hang, spin or exit
+ *   STUB_WM_AFTER         ms after taking the selection to do it
+ *   STUB_WM_EXIT          exit code for exit mode
+ *   STUB_WM_FPS           paint the root at this rate, like a compositor
+ *   STUB_WM_STALL         ms to stall a frame for ...
+ *   STUB_WM_STALL_EVERY   ... every that many frames
+ */
+#include <xcb/xcb.h>
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+static xcb_connection_t* conn;
+static xcb_screen_t* screen;
+static xcb_window_t self;
+static xcb_atom_t selection;
+
+static int env_int(const char* name, int def)
+{
+    const char* v = getenv(name);
+    return v && *v ? atoi(v) : def;
+}
+
+static std::string env_str(const char* name, const char* def)
+{
+    const char* v = getenv(name);
+    return v && *v ? v : def;
+}
+
+static long long now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static xcb_atom_t intern(const char* name)
+{
+    auto* reply = xcb_intern_atom_reply(conn, xcb_intern_atom(conn, 0, strlen(name), name), NULL);
+    xcb_atom_t atom = reply ? reply->atom : XCB_NONE;
+    free(reply);
+    return atom;
+}
+
+static xcb_window_t selection_owner()
+{
+    auto* reply = xcb_get_selection_owner_reply(conn, xcb_get_selection_owner(conn, selection), NULL);
+    xcb_window_t owner = reply ? reply->owner : XCB_NONE;
+    free(reply);
+    return owner;
+}
+
+/**
+ * false once another wm took the selection from us
+ */
+static bool handle_events()
+{
+    xcb_generic_event_t* ev;
+    bool keep = true;
+    while ((ev = xcb_poll_for_event(conn))) {
+        if ((ev->response_type & ~0x80) == XCB_SELECTION_CLEAR) {
+            auto* clear = (xcb_selection_clear_event_t*)ev;
+            keep = keep && clear->selection != selection;
+        }
+        free(ev);
+    }
+    return keep && !xcb_connection_has_error(conn);
+}
+
+static bool take_selection(bool replace, int screen_no)
+{
+    char name[32];
+    snprintf(name, sizeof name, "WM_S%d", screen_no);
+    selection = intern(name);
+
+    xcb_window_t old = selection_owner();
+    if (old != XCB_NONE) {
+        if (!replace) {
+            fprintf(stderr, "stub-wm: %s is owned, try --replace\n", name);
+            return false;
+        }
+        uint32_t mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+        xcb_change_window_attributes(conn, old, XCB_CW_EVENT_MASK, &mask);
+    }
+
+    xcb_set_selection_owner(conn, self, selection, XCB_CURRENT_TIME);
+    if (selection_owner() != self) {
+        fprintf(stderr, "stub-wm: can not own %s\n", name);
+        return false;
+    }
+
+    // the old wm is expected to go away now
+    for (long long deadline = now_ms() + 3000; old != XCB_NONE && now_ms() < deadline;) {
+        xcb_flush(conn);
+        struct pollfd pfd = {xcb_get_file_descriptor(conn), POLLIN, 0};
+        poll(&pfd, 1, 50);
+
+        xcb_generic_event_t* ev;
+        while ((ev = xcb_poll_for_event(conn))) {
+            if ((ev->response_type & ~0x80) == XCB_DESTROY_NOTIFY
+                    && ((xcb_destroy_notify_event_t*)ev)->window == old) {
+                old = XCB_NONE;
+            }
+            free(ev);
+        }
+    }
+
+    // ICCCM: announce the new manager to everyone listening on root
+    xcb_client_message_event_t msg;
+    memset(&msg, 0, sizeof msg);
+    msg.response_type = XCB_CLIENT_MESSAGE;
+    msg.format = 32;
+    msg.window = screen->root;
+    msg.type = intern("MANAGER");
+    msg.data.data32[0] = XCB_CURRENT_TIME;
+    msg.data.data32[1] = selection;
+    msg.data.data32[2] = self;
+    xcb_send_event(conn, 0, screen->root, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (const char*)&msg);
+    return true;
+}
+
+static void advertise(const std::string& name)
+{
+    xcb_atom_t check = intern("_NET_SUPPORTING_WM_CHECK");
+    xcb_atom_t wm_name = intern("_NET_WM_NAME");
+    xcb_atom_t utf8 = intern("UTF8_STRING");
+    xcb_atom_t wm_pid = intern("_NET_WM_PID");
+    uint32_t pid = getpid();
+
+    xcb_change_property(conn, XCB_PROP_MODE_REPLACE, self, wm_name, utf8, 8, name.size(), name.data());
+    xcb_change_property(conn, XCB_PROP_MODE_REPLACE, self, wm_pid, XCB_ATOM_CARDINAL, 32, 1, &pid);
+    xcb_change_property(conn, XCB_PROP_MODE_REPLACE, self, check, XCB_ATOM_WINDOW, 32, 1, &self);
+    xcb_change_property(conn, XCB_PROP_MODE_REPLACE, screen->root, check, XCB_ATOM_WINDOW, 32, 1, &self);
+}
+
+class Painter {
+    public:
+        Painter(int fps, int stall, int every)
+            :_period(fps > 0 ? 1000000000LL / fps : 0), _stall(stall), _every(every) {
+            if (!_period) return;
+
+            _gc = xcb_generate_id(conn);
+            uint32_t values[] = {screen->black_pixel, screen->white_pixel};
+            xcb_create_gc(conn, _gc, screen->root, XCB_GC_FOREGROUND | XCB_GC_BACKGROUND, values);
+            clock_gettime(CLOCK_MONOTONIC, &_next);
+        }
+
+        bool active() const { return _period > 0; }
+
+        /**
+         * ms until the next frame is due
+         */
+        int due() const {
+            if (!_period) return -1;
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            long long ns = (_next.tv_sec - ts.tv_sec) * 1000000000LL + (_next.tv_nsec - ts.tv_nsec);
+            return ns > 0 ? int(ns / 1000000) : 0;
+        }
+
+        void paint() {
+            if (!_period) return;
+            // the last ms are waited out exactly, poll() is too coarse
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &_next, NULL);
+
+            // a changing pixel somewhere damages the root
+            uint32_t pixel = _painted++ & 1 ? screen->white_pixel : screen->black_pixel;
+            xcb_change_gc(conn, _gc, XCB_GC_FOREGROUND, &pixel);
+            xcb_rectangle_t r = {0, 0, 8, 8};
+            xcb_poly_fill_rectangle(conn, screen->root, _gc, 1, &r);
+            xcb_flush(conn);
+
+            long long step = _period;
+            if (_every > 0 && ++_frames % _every == 0) {
+                step += _stall * 1000000LL;
+            }
+            _next.tv_nsec += step % 1000000000LL;
+            _next.tv_sec += step / 1000000000LL + _next.tv_nsec / 1000000000LL;
+            _next.tv_nsec %= 1000000000LL;
+        }
+
+    private:
+        long long _period;
+        int _stall;
+        int _every;
+        xcb_gcontext_t _gc {0};
+        struct timespec _next;
+        long long _frames {0};
+        long long _painted {0};
+};
+
+int main(int argc, char* argv[])
+{
+    bool replace = false;
+    for (int i = 1; i < argc; i++) {
+        replace = replace || strcmp(argv[i], "--replace") == 0;
+    }
+
+    int screen_no = 0;
+    conn = xcb_connect(NULL, &screen_no);
+    if (xcb_connection_has_error(conn)) {
+        fprintf(stderr, "stub-wm: can not connect to display\n");
+        return 2;
+    }
+
+    auto it = xcb_setup_roots_iterator(xcb_get_setup(conn));
+    for (int i = 0; i < screen_no && it.rem; i++) {
+        xcb_screen_next(&it);
+    }
+    screen = it.data;
+
+    self = xcb_generate_id(conn);
+    xcb_create_window(conn, XCB_COPY_FROM_PARENT, self, screen->root, -1, -1, 1, 1, 0,
+            XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, NULL);
+
+    if (!take_selection(replace, screen_no)) {
+        return 3;
+    }
+
+    std::string mode = env_str("STUB_WM_MODE", "run");
+    advertise(env_str("STUB_WM_NAME", "stub wm"));
+    xcb_flush(conn);
+
+    Painter painter(env_int("STUB_WM_FPS", 0), env_int("STUB_WM_STALL", 0),
+            env_int("STUB_WM_STALL_EVERY", 0));
+    long long act_at = now_ms() + env_int("STUB_WM_AFTER", 0);
+    bool acted = mode == "run";
+
+    for (;;) {
+        if (!handle_events()) {
+            // replaced, or the server went away
+            return 0;
+        }
+
+        if (!acted && now_ms() >= act_at) {
+            acted = true;
+            if (mode == "crash") {
+                abort();
+            } else if (mode == "exit") {
+                return env_int("STUB_WM_EXIT", 1);
+            } else if (mode == "hang") {
+                // neither reads events nor exits, like a deadlocked wm
+                for (;;) pause();
+            } else if (mode == "spin") {
+                // a core at 100%, still leaving when replaced
+                for (volatile unsigned long n = 0;; n++) {
+                    if ((n & 0xfffff) == 0 && !handle_events()) return 0;
+                }
+            }
+        }
+
+        int timeout = acted ? -1 : int(std::max(act_at - now_ms(), 0LL));
+        if (painter.active()) {
+            int due = std::max(painter.due() - 1, 0);
+            timeout = timeout < 0 ? due : std::min(due, timeout);
+        }
+
+        struct pollfd pfd = {xcb_get_file_descriptor(conn), POLLIN, 0};
+        poll(&pfd, 1, timeout);
+        if (painter.active() && painter.due() <= 1) {
+            painter.paint();
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QtCore>
+#include <QX11Info>
+
+#include <string.h>
+#include <xcb/xcb.h>
+
+namespace wmm {
+/**
+ * what the stub wm managing the screen says about itself, read from the
+ * window _NET_SUPPORTING_WM_CHECK on root points to. all empty if there
+ * is none, or it is gone.
+ */
+struct StubWM {
+    xcb_window_t check {XCB_NONE};
+    QString name;
+    qint64 pid {0};
+
+    static StubWM running();
+    static QJsonObject rung(const QString& id, bool is3D, int cost,
+            const QJsonObject& env = QJsonObject());
+};
+
+static inline xcb_atom_t stub_intern(xcb_connection_t* conn, const char* name)
+{
+    auto* reply = xcb_intern_atom_reply(conn, xcb_intern_atom(conn, 0, strlen(name), name), NULL);
+    xcb_atom_t atom = reply ? reply->atom : XCB_NONE;
+    free(reply);
+    return atom;
+}
+
+static inline QByteArray stub_property(xcb_connection_t* conn, xcb_window_t w, xcb_atom_t prop)
+{
+    // a gone window is expected, keep the error away from Qt
+    xcb_generic_error_t* error = nullptr;
+    auto* reply = xcb_get_property_reply(conn,
+            xcb_get_property(conn, 0, w, prop, XCB_GET_PROPERTY_TYPE_ANY, 0, 1024), &error);
+    free(error);
+    if (!reply) return QByteArray();
+
+    QByteArray value((const char*)xcb_get_property_value(reply),
+            xcb_get_property_value_length(reply));
+    free(reply);
+    return value;
+}
+
+inline StubWM StubWM::running()
+{
+    auto* conn = QX11Info::connection();
+    StubWM wm;
+
+    auto root = stub_property(conn, QX11Info::appRootWindow(),
+            stub_intern(conn, "_NET_SUPPORTING_WM_CHECK"));
+    if (root.size() != 4) return wm;
+    xcb_window_t check = *(const quint32*)root.constData();
+
+    // the property on root outlives the wm, its own copy does not
+    auto self = stub_property(conn, check, stub_intern(conn, "_NET_SUPPORTING_WM_CHECK"));
+    if (self != root) return wm;
+
+    wm.check = check;
+    wm.name = QString::fromUtf8(stub_property(conn, check, stub_intern(conn, "_NET_WM_NAME")));
+    auto pid = stub_property(conn, check, stub_intern(conn, "_NET_WM_PID"));
+    if (pid.size() == 4) wm.pid = *(const quint32*)pid.constData();
+    return wm;
+}
+
+/**
+ * a rung of the wm ladder running the stub wm, named after id
+ */
+inline QJsonObject StubWM::rung(const QString& id, bool is3D, int cost, const QJsonObject& env)
+{
+    QJsonObject vars = env;
+    vars["STUB_WM_NAME"] = id;
+
+    QJsonObject rung;
+    rung["id"] = id;
+    rung["exec"] = QString(STUB_WM);
+    rung["cost"] = cost;
+    rung["3d"] = is3D;
+    rung["env"] = vars;
+    return rung;
+}
+}
@@ -0,0 +1,137 @@
+#include "config.h"
+#include "config_manager.h"
+
+#include <QtTest>
+
+using namespace wmm;
+
+/**
+ * keeps the single writer thread of a Config busy until released, like
+ * a home on a slow NFS server
+ */
+class SlowDisk: public QRunnable {
+    public:
+        QSemaphore started;
+        QSemaphore release;
+
+        void run() override {
+            started.release();
+            release.acquire();
+        }
+};
+
+class TestConfig: public QObject {
+    Q_OBJECT
+    private slots:
+        void initTestCase();
+        void init();
+
+        void saveAndLoad();
+        void externalEdit();
+        void slowWriteNotReverted();
+
+    private:
+        QString _path;
+
+        void writeFile(const QJsonObject& obj);
+        QJsonObject readFile();
+};
+
+void TestConfig::initTestCase()
+{
+    // ~/.qttest/config instead of the real one
+    QStandardPaths::setTestModeEnabled(true);
+    _path = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)
+        + "/deepin/deepin-wm-switcher/config.json";
+}
+
+void TestConfig::init()
+{
+    QFile::remove(_path);
+    QJsonObject obj;
+    obj["last_wm"] = "old-wm";
+    writeFile(obj);
+}
+
+void TestConfig::writeFile(const QJsonObject& obj)
+{
+    QVERIFY(QDir().mkpath(QFileInfo(_path).path()));
+    QSaveFile f(_path);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(QJsonDocument(obj).toJson());
+    QVERIFY(f.commit());
+}
+
+QJsonObject TestConfig::readFile()
+{
+    QFile f(_path);
+    if (!f.open(QIODevice::ReadOnly)) return QJsonObject();
+    return QJsonDocument::fromJson(f.readAll()).object();
+}
+
+void TestConfig::saveAndLoad()
+{
+    Config c;
+    c.load();
+    QCOMPARE(c.currentWM(), QString("old-wm"));
+
+    c.selectWM("new-wm");
+    QTRY_COMPARE_WITH_TIMEOUT(readFile()["last_wm"].toString(), QString("new-wm"), 3000);
+}
+
+void TestConfig::externalEdit()
+{
+    Config c;
+    c.load();
+    c.watch();
+    QSignalSpy changed(&c, SIGNAL(changed()));
+
+    QJsonObject obj;
+    obj["last_wm"] = "edited-wm";
+    writeFile(obj);
+
+    QTRY_COMPARE_WITH_TIMEOUT(changed.count(), 1, 3000);
+    QCOMPARE(c.currentWM(), QString("edited-wm"));
+}
+
+void TestConfig::slowWriteNotReverted()
+{
+    Config c;
+    c.load();
+    c.watch();
+    QSignalSpy changed(&c, SIGNAL(changed()));
+    QSignalSpy reloaded(&c, SIGNAL(reloaded()));
+
+    auto* disk = new SlowDisk;
+    disk->setAutoDelete(false);
+    c._writer.start(disk);
+    QVERIFY(disk->started.tryAcquire(1, 3000));
+
+    // queued behind the slow disk, the old file stays for now
+    c.selectWM("new-wm");
+    QTRY_COMPARE_WITH_TIMEOUT(c._saveTimer.isActive(), false, 3000);
+    QCOMPARE(c.currentWM(), QString("new-wm"));
+
+    // something else in the directory makes it look again
+    QFile other(QFileInfo(_path).path() + "/other");
+    QVERIFY(other.open(QIODevice::WriteOnly));
+    other.close();
+    QTest::qWait(1500);
+    QCOMPARE(c.currentWM(), QString("new-wm"));
+    QCOMPARE(changed.count(), 0);
+
+    // the write lands, which is our own and changes nothing
+    disk->release.release();
+    QTRY_COMPARE_WITH_TIMEOUT(readFile()["last_wm"].toString(), QString("new-wm"), 3000);
+    QTest::qWait(1500);
+    QCOMPARE(c.currentWM(), QString("new-wm"));
+    QCOMPARE(changed.count(), 0);
+    QCOMPARE(reloaded.count(), 0);
+
+    c._writer.waitForDone();
+    delete disk;
+    other.remove();
+}
+
+QTEST_GUILESS_MAIN(TestConfig)
+#include "tst_config.moc"
@@ -0,0 +1,150 @@
+#include "config.h"
+#include "frame_pacing.h"
+
+#include <QtTest>
+
+using namespace wmm;
+
+/**
+ * FramePacingMonitor against stub-wm painting the root of Xvfb like a
+ * compositor would, at a steady rate or stalling every so often.
+ */
+class TestFramePacing: public QObject {
+    Q_OBJECT
+    private slots:
+        void cleanup();
+
+        void smooth();
+        void stalls_data();
+        void stalls();
+        void steadilySlow_data();
+        void steadilySlow();
+        void slowUpdates();
+        void policyFromJson();
+
+    private:
+        QProcess* _compositor {nullptr};
+        FramePacingMonitor* _monitor {nullptr};
+
+        void paint(int fps, int stall = 0, int every = 0);
+};
+
+void TestFramePacing::cleanup()
+{
+    delete _monitor;
+    _monitor = nullptr;
+    if (_compositor) {
+        _compositor->kill();
+        _compositor->waitForFinished();
+        delete _compositor;
+        _compositor = nullptr;
+    }
+}
+
+void TestFramePacing::paint(int fps, int stall, int every)
+{
+    auto env = QProcessEnvironment::systemEnvironment();
+    env.insert("STUB_WM_NAME", "stub-compositor");
+    env.insert("STUB_WM_FPS", QString::number(fps));
+    env.insert("STUB_WM_STALL", QString::number(stall));
+    env.insert("STUB_WM_STALL_EVERY", QString::number(every));
+
+    _compositor = new QProcess;
+    _compositor->setProcessEnvironment(env);
+    _compositor->setProcessChannelMode(QProcess::ForwardedChannels);
+    _compositor->start(STUB_WM, QStringList() << "--replace");
+    QVERIFY(_compositor->waitForStarted());
+
+    FramePacingPolicy p;
+    p.duration = 1;
+    p.interval = 1;
+    p.window = 2;
+    p.minFrames = 20;
+
+    _monitor = new FramePacingMonitor;
+    _monitor->setPolicy(p);
+    _monitor->watch();
+}
+
+void TestFramePacing::smooth()
+{
+    paint(60);
+    QSignalSpy janky(_monitor, SIGNAL(janky(double)));
+
+    QTRY_VERIFY_WITH_TIMEOUT(_monitor->p95() > 0, 5000);
+    QTest::qWait(4000);
+    QCOMPARE(janky.count(), 0);
+    QVERIFY(_monitor->p95() < FramePacingPolicy().low);
+}
+
+void TestFramePacing::stalls_data()
+{
+    QTest::addColumn<int>("stall");
+    QTest::addColumn<int>("every");
+
+    QTest::newRow("120ms every 10 frames") << 120 << 10;
+    QTest::newRow("400ms every 12 frames") << 400 << 12;
+}
+
+void TestFramePacing::stalls()
+{
+    QFETCH(int, stall);
+    QFETCH(int, every);
+
+    // stalls inside an animation are frames missed, however long
+    paint(60, stall, every);
+    QSignalSpy janky(_monitor, SIGNAL(janky(double)));
+
+    QTRY_COMPARE_WITH_TIMEOUT(janky.count(), 1, 10000);
+    QVERIFY(janky.first().first().toDouble() >= stall);
+}
+
+void TestFramePacing::steadilySlow_data()
+{
+    QTest::addColumn<int>("fps");
+
+    QTest::newRow("15fps") << 15;
+    QTest::newRow("18fps") << 18;
+}
+
+void TestFramePacing::steadilySlow()
+{
+    QFETCH(int, fps);
+
+    // software rendering, every frame late and never a smooth run
+    paint(fps);
+    QSignalSpy janky(_monitor, SIGNAL(janky(double)));
+
+    QTRY_COMPARE_WITH_TIMEOUT(janky.count(), 1, 10000);
+    QVERIFY(janky.first().first().toDouble() >= 1000 / fps - 1);
+}
+
+void TestFramePacing::slowUpdates()
+{
+    // slower than policy.maxFrame, a gif rather than the compositor
+    paint(10);
+    QSignalSpy janky(_monitor, SIGNAL(janky(double)));
+
+    QTest::qWait(5000);
+    QCOMPARE(janky.count(), 0);
+    QCOMPARE(_monitor->p95(), -1.0);
+}
+
+void TestFramePacing::policyFromJson()
+{
+    QJsonObject obj;
+    obj["high"] = 2000;
+    obj["idle_gap"] = 500;
+    obj["min_run"] = 1;
+    obj["max_frame"] = 0;
+
+    auto p = FramePacingPolicy::fromJson(obj);
+    QCOMPARE(p.high, 2000);
+    QCOMPARE(p.idleGap, 500);
+    QCOMPARE(p.minRun, 2);
+    QCOMPARE(p.maxFrame, 1);
+    QCOMPARE(FramePacingPolicy::fromJson(QJsonObject()).idleGap, 1000);
+}
+
+QTEST_MAIN(TestFramePacing)
+#include "tst_frame_pacing.moc"
@@ -0,0 +1,149 @@
+#include "config.h"
+#include "monitor.h"
+#include "window_manager.h"
+#include "stub_wm_client.h"
+
+#include <QtTest>
+
+#include <signal.h>
+
+using namespace wmm;
+
+/**
+ * WindowManagerMonitor against stub wms on Xvfb, see run-xvfb.sh
+ */
+class TestMonitor: public QObject {
+    Q_OBJECT
+    private slots:
+        void initTestCase();
+        void cleanup();
+
+        void spawn();
+        void toggle();
+        void crashRecovery();
+        void hogDetection();
+        void breaker();
+
+    private:
+        WindowManagerMonitor* _monitor {nullptr};
+
+        void start(const QJsonObject& env3d, const QJsonObject& env2d = QJsonObject());
+};
+
+void TestMonitor::initTestCase()
+{
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)
+        + "/deepin/deepin-wm-switcher";
+    QVERIFY(QDir().mkpath(dir));
+
+    // run-xvfb.sh gives us a config dir of our own
+    QJsonObject hog;
+    hog["high"] = 80;
+    hog["low"] = 40;
+    hog["duration"] = 2;
+    hog["interval"] = 1;
+    QJsonObject off;
+    off["enabled"] = false;
+
+    QJsonObject cfg;
+    cfg["cpu_hog"] = hog;
+    cfg["frame_pacing"] = off;
+    cfg["pressure"] = off;
+
+    QFile f(dir + "/config.json");
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(QJsonDocument(cfg).toJson());
+    f.close();
+
+    global_config.load();
+}
+
+void TestMonitor::cleanup()
+{
+    // kills the wms it spawned
+    delete _monitor;
+    _monitor = nullptr;
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().check, xcb_window_t(XCB_NONE), 5000);
+}
+
+void TestMonitor::start(const QJsonObject& env3d, const QJsonObject& env2d)
+{
+    QJsonArray ladder;
+    ladder.append(StubWM::rung("stub-3d", true, 100, env3d));
+    ladder.append(StubWM::rung("stub-2d", false, 30, env2d));
+    QVERIFY(load_ladder(ladder));
+    switch_permission = ALLOW_BOTH;
+
+    _monitor = new WindowManagerMonitor;
+    _monitor->start(good_wm);
+}
+
+void TestMonitor::spawn()
+{
+    start(QJsonObject());
+
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-3d"), 5000);
+    QCOMPARE(_monitor->currentWM(), QString("stub-3d"));
+    QVERIFY(StubWM::running().pid > 0);
+}
+
+void TestMonitor::toggle()
+{
+    start(QJsonObject());
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-3d"), 5000);
+    auto old = StubWM::running();
+
+    _monitor->onToggleWM();
+
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-2d"), 5000);
+    QCOMPARE(_monitor->currentWM(), QString("stub-2d"));
+    // the replaced one left by itself
+    QTRY_VERIFY_WITH_TIMEOUT(kill(old.pid, 0) != 0, 5000);
+    // timed up to the post actions
+    QTRY_VERIFY_WITH_TIMEOUT(!_monitor->switchTimer().last().isEmpty(), 5000);
+}
+
+void TestMonitor::crashRecovery()
+{
+    QJsonObject crash;
+    crash["STUB_WM_MODE"] = "crash";
+    crash["STUB_WM_AFTER"] = 500;
+    start(crash);
+
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-3d"), 5000);
+    // one rung down once it crashed
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-2d"), 10000);
+    QCOMPARE(_monitor->currentWM(), QString("stub-2d"));
+    QCOMPARE(_monitor->breaker().state(), CrashBreaker::Closed);
+}
+
+void TestMonitor::hogDetection()
+{
+    QJsonObject spin;
+    spin["STUB_WM_MODE"] = "spin";
+    start(spin);
+
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-3d"), 5000);
+    // 2s over 80% at 1s samples, and some slack for a loaded machine
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().name, QString("stub-2d"), 15000);
+    QCOMPARE(_monitor->currentWM(), QString("stub-2d"));
+}
+
+void TestMonitor::breaker()
+{
+    QJsonObject crash;
+    crash["STUB_WM_MODE"] = "crash";
+    start(crash, crash);
+
+    // both rungs crash right away, it gives up instead of looping
+    QTRY_COMPARE_WITH_TIMEOUT(_monitor->breaker().state(), CrashBreaker::Open, 30000);
+    QTRY_COMPARE_WITH_TIMEOUT(StubWM::running().check, xcb_window_t(XCB_NONE), 5000);
+
+    // and stays put
+    QTest::qWait(2000);
+    QCOMPARE(StubWM::running().check, xcb_window_t(XCB_NONE));
+    QCOMPARE(_monitor->breaker().state(), CrashBreaker::Open);
+}
+
+QTEST_MAIN(TestMonitor)
+#include "tst_monitor.moc"
@@ -0,0 +1,157 @@
+#include "config.h"
+#include "pressure.h"
+
+#include <QtTest>
+
+using namespace wmm;
+
+/**
+ * stalls when told to, instead of when the kernel says so
+ */
+class FakePressureSource: public PressureSource {
+    Q_OBJECT
+    public:
+        bool started {false};
+        PressurePolicy policy;
+
+        bool start(const PressurePolicy& p) override {
+            policy = p;
+            started = true;
+            return true;
+        }
+
+        void stop() override { started = false; }
+
+        void stall(const QString& resource = "memory") { emit stalled(resource); }
+};
+
+class TestPressure: public QObject {
+    Q_OBJECT
+    private slots:
+        void init();
+        void cleanup();
+
+        void startsSource();
+        void raisedAfterSustain();
+        void streakBroken();
+        void stopClears();
+        void windowRounded_data();
+        void windowRounded();
+
+    private:
+        PressureWatcher* _watcher {nullptr};
+        FakePressureSource* _source {nullptr};
+        PressurePolicy _policy;
+};
+
+void TestPressure::init()
+{
+    _watcher = new PressureWatcher;
+    _source = new FakePressureSource;
+    _watcher->setSource(_source);
+
+    // not through fromJson, which would round the window up to 2s
+    _policy.window = 200;
+    _policy.sustain = 1;
+    _policy.recover = 1;
+}
+
+void TestPressure::cleanup()
+{
+    delete _watcher;
+    _watcher = nullptr;
+    _source = nullptr;
+}
+
+void TestPressure::startsSource()
+{
+    QVERIFY(_watcher->start(_policy));
+    QVERIFY(_source->started);
+    QCOMPARE(_source->policy.window, 200);
+
+    _watcher->stop();
+    QVERIFY(!_source->started);
+}
+
+void TestPressure::raisedAfterSustain()
+{
+    QSignalSpy raised(_watcher, SIGNAL(raised()));
+    QSignalSpy cleared(_watcher, SIGNAL(cleared()));
+    QVERIFY(_watcher->start(_policy));
+
+    // a stall every window, raised once they kept coming for sustain
+    for (int i = 0; i < 4; i++) {
+        _source->stall();
+        QCOMPARE(raised.count(), 0);
+        QTest::qWait(_policy.window);
+    }
+    QTest::qWait(300);
+    _source->stall("cpu");
+    QCOMPARE(raised.count(), 1);
+    QVERIFY(_watcher->isRaised());
+
+    // more stalls do not raise it again
+    _source->stall();
+    QCOMPARE(raised.count(), 1);
+
+    QTRY_COMPARE_WITH_TIMEOUT(cleared.count(), 1, _policy.recover * 1000 + 1000);
+    QVERIFY(!_watcher->isRaised());
+}
+
+void TestPressure::streakBroken()
+{
+    QSignalSpy raised(_watcher, SIGNAL(raised()));
+    QVERIFY(_watcher->start(_policy));
+
+    _source->stall();
+    // missing two windows ends the streak
+    QTest::qWait(_policy.window * 2 + 700);
+    _source->stall();
+    QTest::qWait(300);
+    _source->stall();
+    QCOMPARE(raised.count(), 0);
+}
+
+void TestPressure::stopClears()
+{
+    _policy.sustain = 0;
+    QSignalSpy cleared(_watcher, SIGNAL(cleared()));
+    QVERIFY(_watcher->start(_policy));
+
+    _source->stall();
+    QVERIFY(_watcher->isRaised());
+
+    _watcher->stop();
+    QVERIFY(!_watcher->isRaised());
+    // nothing pending fires after
+    QTest::qWait(_policy.recover * 1000 + 500);
+    QCOMPARE(cleared.count(), 0);
+}
+
+void TestPressure::windowRounded_data()
+{
+    QTest::addColumn<int>("window");
+    QTest::addColumn<int>("rounded");
+
+    QTest::newRow("too short") << 500 << 2000;
+    QTest::newRow("2s") << 2000 << 2000;
+    QTest::newRow("odd") << 3000 << 4000;
+    QTest::newRow("too long") << 15000 << 10000;
+}
+
+void TestPressure::windowRounded()
+{
+    QFETCH(int, window);
+    QFETCH(int, rounded);
+
+    QJsonObject obj;
+    obj["window"] = window;
+    obj["memory_stall"] = 5000;
+    auto p = PressurePolicy::fromJson(obj);
+    QCOMPARE(p.window, rounded);
+    // a stall can not be longer than its window
+    QCOMPARE(p.memoryStall, rounded);
+}
+
+QTEST_GUILESS_MAIN(TestPressure)
+#include "tst_pressure.moc"
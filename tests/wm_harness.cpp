@@ -0,0 +1,160 @@
+/**
+ * Runs the switcher against stub wms on Xvfb and reports how long it
+ * takes to bring up a wm, to switch and to recover from a crash, and
+ * what the switcher itself costs while idle. Run through run-xvfb.sh.
+ *
+ *   wm-harness [switches] [idle seconds]
+ */
+#include "config.h"
+#include "metrics.h"
+#include "monitor.h"
+#include "stub_wm_client.h"
+
+#include <QtGui>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+using namespace wmm;
+
+static bool wait_for(const std::function<bool()>& cond, int timeout)
+{
+    QElapsedTimer t;
+    t.start();
+    while (!cond()) {
+        if (t.elapsed() > timeout) return false;
+        // sleep in the event loop, spinning would show up as our cpu
+        QEventLoop loop;
+        QTimer::singleShot(10, &loop, SLOT(quit()));
+        loop.exec();
+    }
+    return true;
+}
+
+static bool wait_for_wm(const QString& name, xcb_window_t not_check = XCB_NONE)
+{
+    return wait_for([&]() {
+        auto wm = StubWM::running();
+        return wm.name == name && wm.check != not_check;
+    }, 10000);
+}
+
+/**
+ * utime + stime of this process in ms
+ */
+static qint64 cpu_ms()
+{
+    QFile f("/proc/self/stat");
+    if (!f.open(QIODevice::ReadOnly)) return -1;
+    auto s = f.readAll();
+    // comm may hold spaces, fields count from after it
+    auto fields = s.mid(s.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13) return -1;
+    return (fields[11].toLongLong() + fields[12].toLongLong()) * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+static qint64 rss_kb()
+{
+    QFile f("/proc/self/status");
+    if (!f.open(QIODevice::ReadOnly)) return -1;
+    for (auto line: f.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+
+static void report(const char* what, QVector<qint64> ms)
+{
+    if (ms.isEmpty()) return;
+    std::sort(ms.begin(), ms.end());
+    auto at = [&](double q) { return ms[qMin(int(q * ms.size()), ms.size() - 1)]; };
+    std::cout << what << " ms: n " << ms.size() << " min " << ms.first()
+        << " median " << at(0.5) << " p95 " << at(0.95) << " max " << ms.last() << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+    int switches = argc > 1 ? atoi(argv[1]) : 20;
+    int idle = argc > 2 ? atoi(argv[2]) : 10;
+
+    QJsonObject off;
+    off["enabled"] = false;
+    QJsonObject cfg;
+    cfg["frame_pacing"] = off;
+    cfg["pressure"] = off;
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)
+        + "/deepin/deepin-wm-switcher";
+    QDir().mkpath(dir);
+    QFile f(dir + "/config.json");
+    if (f.open(QIODevice::WriteOnly)) {
+        f.write(QJsonDocument(cfg).toJson());
+        f.close();
+    }
+    global_config.load();
+
+    QJsonArray ladder;
+    ladder.append(StubWM::rung("stub-3d", true, 100));
+    ladder.append(StubWM::rung("stub-2d", false, 30));
+    load_ladder(ladder);
+    switch_permission = ALLOW_BOTH;
+
+    WindowManagerMonitor monitor;
+    QElapsedTimer t;
+    t.start();
+    monitor.start(good_wm);
+    if (!wait_for_wm("stub-3d")) {
+        std::cerr << "stub-3d never came up" << std::endl;
+        return 1;
+    }
+    std::cout << "startup ms: " << t.elapsed() << std::endl;
+
+    QVector<qint64> switched;
+    for (int i = 0; i < switches; i++) {
+        QString to = monitor.currentWM() == "stub-3d" ? "stub-2d" : "stub-3d";
+        t.restart();
+        monitor.onToggleWM();
+        if (!wait_for_wm(to)) {
+            std::cerr << "switch to " << qPrintable(to) << " timed out" << std::endl;
+            return 1;
+        }
+        switched << t.elapsed();
+    }
+    report("switch", switched);
+
+    // respawns back off, a few crashes are enough
+    QVector<qint64> recovered;
+    for (int i = 0; i < 3; i++) {
+        auto wm = StubWM::running();
+        t.restart();
+        kill(wm.pid, SIGSEGV);
+        if (!wait_for([&]() {
+            auto now = StubWM::running();
+            return now.check != XCB_NONE && now.check != wm.check;
+        }, 10000)) {
+            std::cerr << "no wm after a crash" << std::endl;
+            return 1;
+        }
+        recovered << t.elapsed();
+        monitor.breaker().reset();
+    }
+    report("crash recovery", recovered);
+
+    qint64 cpu = cpu_ms();
+    t.restart();
+    QEventLoop loop;
+    QTimer::singleShot(idle * 1000, &loop, SLOT(quit()));
+    loop.exec();
+    double busy = 100.0 * (cpu_ms() - cpu) / qMax<qint64>(t.elapsed(), 1);
+    std::cout << "idle cpu %: " << busy << std::endl;
+    std::cout << "rss kB: " << rss_kb() << std::endl;
+
+    std::cout << std::endl << Metrics::instance().exposition().toStdString();
+    return 0;
+}